@@ -0,0 +1,386 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include "poker_networking.hpp"
+
+// Compact binary framing for the same messages as the text protocol in poker_networking.hpp.
+//
+// A connection starts in text. A client that wants binary sends the BinaryHello line first; a
+// server that speaks it answers with the same line, and from then on both directions carry
+// frames instead of lines:
+//
+//   u16 body length | u8 message type | fields
+//
+// Integers are little-endian int32 (u8 for enums and cards), strings and lists carry a u16
+// count in front. Messages are laid out field by field from their fields(), see the schema in
+// poker_networking.hpp. ACTION_RESULT is 12 bytes on the wire and BETTING_UPDATE 23, and decoding is
+// a handful of loads. The text protocol stays for debugging with telnet/nc.
+
+constexpr std::string_view BinaryHello = "HELLO BINARY 2"; // 2: per-type messages, roster split out of WELCOME
+constexpr std::size_t FrameHeaderSize = 2;
+constexpr std::size_t MaxFrameBody = 0xFFFF;
+
+class FrameWriter
+{
+public:
+    // Starts a frame in out (appending, so several frames can share a buffer)
+    constexpr FrameWriter(std::string &out, std::uint8_t type) : out(out), start(out.size())
+    {
+        out.append(FrameHeaderSize, '\0');
+        u8(type);
+    }
+
+    constexpr void u8(std::uint8_t v)
+    {
+        out.push_back(char(v));
+    }
+
+    constexpr void u16(std::uint16_t v)
+    {
+        out.push_back(char(v & 0xFF));
+        out.push_back(char(v >> 8));
+    }
+
+    constexpr void i32(std::int32_t v)
+    {
+        std::uint32_t u = std::uint32_t(v);
+        char bytes[4] = {char(u & 0xFF), char((u >> 8) & 0xFF), char((u >> 16) & 0xFF), char(u >> 24)};
+        out.append(bytes, 4);
+    }
+
+    // Truncated to what still fits in the frame, so one long string can't push it past MaxFrameBody
+    constexpr void str(std::string_view s)
+    {
+        std::size_t used = out.size() - start - FrameHeaderSize + 2;
+        std::size_t room = used < MaxFrameBody ? MaxFrameBody - used : 0;
+        std::size_t n = s.size() < room ? s.size() : room;
+        u16(std::uint16_t(n));
+        out.append(s.data(), n);
+    }
+
+    // Writes the length prefix. If the body outgrew MaxFrameBody anyway the frame is taken back out
+    // of out and it's false: no frame beats one whose length is wrong.
+    constexpr bool finish()
+    {
+        std::size_t body = out.size() - start - FrameHeaderSize;
+        if (body > MaxFrameBody)
+        {
+            out.resize(start);
+            return false;
+        }
+        out[start] = char(body & 0xFF);
+        out[start + 1] = char(body >> 8);
+        return true;
+    }
+
+private:
+    std::string &out;
+    std::size_t start;
+};
+
+// Reads the fields of one frame body. Reading past the end sets failed and returns zeros, so a
+// decoder reads everything and checks once at the end.
+class FrameReader
+{
+public:
+    constexpr explicit FrameReader(std::string_view body) : body(body) {}
+
+    bool failed = false;
+
+    constexpr bool atEnd() const
+    {
+        return pos == body.size();
+    }
+
+    constexpr std::uint8_t u8()
+    {
+        if (!need(1))
+            return 0;
+        return std::uint8_t(body[pos++]);
+    }
+
+    constexpr std::uint16_t u16()
+    {
+        if (!need(2))
+            return 0;
+        std::uint16_t v = std::uint16_t(std::uint8_t(body[pos]) | std::uint8_t(body[pos + 1]) << 8);
+        pos += 2;
+        return v;
+    }
+
+    constexpr std::int32_t i32()
+    {
+        if (!need(4))
+            return 0;
+        std::uint32_t v = 0;
+        for (int i = 3; i >= 0; i--)
+            v = v << 8 | std::uint8_t(body[pos + i]);
+        pos += 4;
+        return std::int32_t(v);
+    }
+
+    // Points into the body. Fails on control characters, see isPlainText.
+    constexpr std::string_view str()
+    {
+        std::uint16_t n = u16();
+        if (!need(n))
+            return {};
+        std::string_view s = body.substr(pos, n);
+        pos += n;
+        if (!isPlainText(s))
+        {
+            failed = true;
+            return {};
+        }
+        return s;
+    }
+
+private:
+    std::string_view body;
+    std::size_t pos = 0;
+
+    constexpr bool need(std::size_t n)
+    {
+        if (body.size() - pos < n)
+            failed = true;
+        return !failed;
+    }
+};
+
+// Body length of the frame at the front of data, once its header has arrived
+constexpr std::size_t frame_body_length(const char *data)
+{
+    return std::size_t(std::uint8_t(data[0]) | std::uint8_t(data[1]) << 8);
+}
+
+template <typename T>
+constexpr void write_binary_field(FrameWriter &w, const T &value)
+{
+    if constexpr (std::is_same_v<T, std::string_view>)
+        w.str(value);
+    else if constexpr (std::is_enum_v<T> || std::is_same_v<T, CardIndex>)
+        w.u8(std::uint8_t(value));
+    else if constexpr (std::is_integral_v<T>)
+        w.i32(value);
+    else if constexpr (isFixedList<T>)
+    {
+        w.u16(std::uint16_t(value.size()));
+        for (const auto &item : value)
+            write_binary_field(w, item);
+    }
+    else
+        std::apply([&](auto... field)
+                   { (write_binary_field(w, value.*field), ...); },
+                   T::fields());
+}
+
+template <typename T>
+constexpr void read_binary_field(FrameReader &r, T &value)
+{
+    if constexpr (std::is_same_v<T, std::string_view>)
+        value = r.str();
+    else if constexpr (std::is_same_v<T, CardIndex>)
+    {
+        CardIndex card = r.u8();
+        value = isValidCard(card) ? card : NoCard;
+    }
+    else if constexpr (std::is_enum_v<T>)
+    {
+        std::uint8_t v = r.u8();
+        if (v > lastValue(T{}))
+            r.failed = true;
+        value = T(v);
+    }
+    else if constexpr (std::is_integral_v<T>)
+        value = r.i32();
+    else if constexpr (isFixedList<T>)
+    {
+        std::uint16_t count = r.u16();
+        if (count > T::Capacity)
+            r.failed = true;
+        value.count = r.failed ? 0 : std::uint8_t(count);
+        for (std::size_t i = 0; i < value.count && !r.failed; i++)
+            read_binary_field(r, value.items[i]);
+    }
+    else
+        std::apply([&](auto... field)
+                   { (read_binary_field(r, value.*field), ...); },
+                   T::fields());
+}
+
+// False, and nothing written, if the message doesn't fit in a frame
+template <typename Msg>
+constexpr bool write_binary_message(const Msg &msg, std::string &out)
+{
+    FrameWriter w(out, std::uint8_t(Msg::Type));
+    write_binary_field(w, msg);
+    return w.finish();
+}
+
+// r is past the type byte
+template <typename Msg>
+constexpr bool read_binary_message(FrameReader &r, Msg &msg)
+{
+    read_binary_field(r, msg);
+    return !r.failed && r.atEnd();
+}
+
+template <typename Variant>
+constexpr bool encode_binary(const Variant &m, std::string &out)
+{
+    return std::visit([&out](const auto &msg)
+                      { return write_binary_message(msg, out); },
+                      m);
+}
+
+// The type byte indexes a table with one decoder per message
+template <typename Variant, std::size_t I>
+bool decode_binary_alternative(FrameReader &r, Variant &msg)
+{
+    return read_binary_message(r, msg.template emplace<I>());
+}
+
+// body is a frame without its length prefix, strings in msg point into it. False for an unknown
+// type or a malformed body.
+template <typename Variant>
+bool decode_binary(std::string_view body, Variant &msg)
+{
+    static constexpr auto decoders = []<std::size_t... I>(std::index_sequence<I...>)
+    {
+        return std::array<bool (*)(FrameReader &, Variant &), sizeof...(I)>{&decode_binary_alternative<Variant, I>...};
+    }(std::make_index_sequence<std::variant_size_v<Variant>>());
+
+    FrameReader r(body);
+    std::uint8_t type = r.u8();
+    if (r.failed || type >= decoders.size())
+        return false;
+    return decoders[type](r, msg);
+}
+
+inline bool encode_client_binary(const MessageClientToServer &m, std::string &out)
+{
+    return encode_binary(m, out);
+}
+
+inline std::string encode_client_binary(const MessageClientToServer &m)
+{
+    std::string out;
+    encode_binary(m, out);
+    return out;
+}
+
+inline bool decode_client_binary(std::string_view body, MessageClientToServer &msg)
+{
+    return decode_binary(body, msg);
+}
+
+inline bool encode_server_binary(const MessageServerToClient &m, std::string &out)
+{
+    return encode_binary(m, out);
+}
+
+inline std::string encode_server_binary(const MessageServerToClient &m)
+{
+    std::string out;
+    encode_binary(m, out);
+    return out;
+}
+
+inline bool decode_server_binary(std::string_view body, MessageServerToClient &msg)
+{
+    return decode_binary(body, msg);
+}
+
+// Round trips of every message through both codecs, checked by the compiler: each message is
+// filled with sample values (every field set, lists full, enums and cards in range), written,
+// read back and compared field by field. A schema change that one side can't read back doesn't build.
+namespace SchemaCheck
+{
+template <typename T>
+constexpr void fillSample(T &value, int &seed)
+{
+    seed++;
+    if constexpr (std::is_same_v<T, std::string_view>)
+        value = seed % 2 ? "Alice" : "Bob";
+    else if constexpr (std::is_same_v<T, CardIndex>)
+        value = deckCard(seed % DeckSize);
+    else if constexpr (std::is_enum_v<T>)
+        value = T(seed % (lastValue(T{}) + 1));
+    else if constexpr (std::is_integral_v<T>)
+        value = seed % 3 ? seed * 1009 : -seed;
+    else if constexpr (isFixedList<T>)
+    {
+        value.count = std::uint8_t(T::Capacity);
+        for (auto &item : value.items)
+            fillSample(item, seed);
+    }
+    else
+        std::apply([&](auto... field)
+                   { (fillSample(value.*field, seed), ...); },
+                   T::fields());
+}
+
+template <typename T>
+constexpr bool sameFields(const T &a, const T &b)
+{
+    if constexpr (isFixedList<T>)
+    {
+        if (a.count != b.count)
+            return false;
+        for (std::size_t i = 0; i < a.count; i++)
+        {
+            if (!sameFields(a.items[i], b.items[i]))
+                return false;
+        }
+        return true;
+    }
+    else if constexpr (std::is_class_v<T> && !std::is_same_v<T, std::string_view>)
+        return std::apply([&](auto... field)
+                          { return (sameFields(a.*field, b.*field) && ...); },
+                          T::fields());
+    else
+        return a == b;
+}
+
+template <typename Msg>
+constexpr bool textRoundTrip()
+{
+    Msg sent{}, received{};
+    int seed = int(Msg::Type);
+    fillSample(sent, seed);
+    std::string line;
+    write_text_message(sent, line);
+    TextReader in(strip_line_end(line));
+    return in.word() == Msg::Command && read_text_message(in, received) == ParseError::None && sameFields(sent, received);
+}
+
+template <typename Msg>
+constexpr bool binaryRoundTrip()
+{
+    Msg sent{}, received{};
+    int seed = int(Msg::Type);
+    fillSample(sent, seed);
+    std::string frame;
+    write_binary_message(sent, frame);
+    std::string_view body = std::string_view(frame).substr(FrameHeaderSize);
+    FrameReader r(body);
+    return frame_body_length(frame.data()) == body.size() && r.u8() == std::uint8_t(Msg::Type) &&
+           read_binary_message(r, received) && sameFields(sent, received);
+}
+
+template <typename Variant, std::size_t... I>
+constexpr bool roundTrips(std::index_sequence<I...>)
+{
+    using Table = CommandTable<Variant>;
+    return ((Table::find(std::variant_alternative_t<I, Variant>::Command) == int(I)) && ...) &&
+           (textRoundTrip<std::variant_alternative_t<I, Variant>>() && ...) &&
+           (binaryRoundTrip<std::variant_alternative_t<I, Variant>>() && ...);
+}
+
+static_assert(roundTrips<MessageClientToServer>(std::make_index_sequence<std::variant_size_v<MessageClientToServer>>()));
+static_assert(roundTrips<MessageServerToClient>(std::make_index_sequence<std::variant_size_v<MessageServerToClient>>()));
+static_assert(CommandTable<MessageServerToClient>::find("BOGUS") < 0 && CommandTable<MessageServerToClient>::find("") < 0);
+}
@@ -0,0 +1,41 @@
+#include "bulk_deals.hpp"
+#include "rng.hpp"
+#include <array>
+#include <atomic>
+#include <stdexcept>
+#include <string>
+using namespace std;
+
+static constexpr size_t DealsPerChunk = 4096;
+
+void generateDeals(ThreadPool &pool, uint64_t seed, CardIndex *out, size_t deals, int cardsPerDeal, CardMask composition,
+                   uint64_t firstDeal)
+{
+    array<CardIndex, DeckSize> ordered;
+    int size = 0;
+    for (CardMask rest = composition & FullDeckMask; rest; rest = popLowestCard(rest))
+        ordered[size++] = lowestCard(rest);
+    if (cardsPerDeal < 1 || cardsPerDeal > size)
+        throw invalid_argument("deals: " + to_string(cardsPerDeal) + " cards per deal from a " + to_string(size) + " card deck");
+
+    atomic<size_t> nextChunk{0};
+    pool.runOnAll([&](unsigned)
+                  {
+        size_t chunk;
+        while ((chunk = nextChunk.fetch_add(1)) * DealsPerChunk < deals)
+        {
+            size_t end = min(deals, (chunk + 1) * DealsPerChunk);
+            for (size_t d = chunk * DealsPerChunk; d < end; d++)
+            {
+                // Each deal starts from the ordered deck, so it doesn't depend on what this worker dealt before
+                array<CardIndex, DeckSize> cards = ordered;
+                Xoshiro256 rng = Xoshiro256::forStream(seed, firstDeal + d);
+                CardIndex *deal = out + d * cardsPerDeal;
+                for (int k = 0; k < cardsPerDeal; k++)
+                {
+                    swap(cards[k], cards[k + rng.bounded(uint32_t(size - k))]);
+                    deal[k] = cards[k];
+                }
+            }
+        } });
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "card_mask.hpp"
+#include "thread_pool.hpp"
+
+// Shuffled deals in bulk, for bot training and simulations that need millions of them.
+//
+// Deal d is the first cardsPerDeal cards of a uniformly shuffled deck (the whole deck when
+// cardsPerDeal is the deck size) drawn with Xoshiro256::forStream(seed, d). Every deal has its
+// own stream, so the output only depends on the seed and the deal numbers: any thread count,
+// and any way of splitting a run into calls, gives the same cards.
+
+// Writes deals [firstDeal, firstDeal + deals) to out, cardsPerDeal CardIndex bytes each, spread
+// over the pool. Throws std::invalid_argument when cardsPerDeal is 0 or more than the composition holds.
+void generateDeals(ThreadPool &pool, std::uint64_t seed, CardIndex *out, std::size_t deals, int cardsPerDeal,
+                   CardMask composition = FullDeckMask, std::uint64_t firstDeal = 0);
@@ -0,0 +1,86 @@
+#pragma once
+#include <bit>
+#include <cstdint>
+#include <utility>
+
+// Compact card representation shared by the engine, the deck and the protocol.
+//
+// A card is one byte: the low nibble is value - 2 (deuce = 0 ... ace = 12) and the high nibble is
+// the suit. The index doubles as the card's bit in a CardMask, so each suit is a 16-bit lane of
+// the mask, sets of cards are single integers and dead-card checks are one AND.
+
+using CardIndex = std::uint8_t;
+using CardMask = std::uint64_t;
+
+using hand = std::pair<CardIndex, CardIndex>; // Hold'em hole cards
+
+constexpr CardIndex NoCard = 0xFF;
+constexpr int DeckSize = 52;
+constexpr CardMask FullDeckMask = 0x1FFF1FFF1FFF1FFFull;
+
+constexpr CardIndex makeCard(int value, int suit)
+{
+    return CardIndex(suit << 4 | (value - 2));
+}
+
+constexpr int cardValue(CardIndex card)
+{
+    return (card & 0xF) + 2;
+}
+
+constexpr int cardSuit(CardIndex card)
+{
+    return card >> 4;
+}
+
+constexpr bool isValidCard(int card)
+{
+    return card >= 0 && card < 64 && ((FullDeckMask >> card) & 1);
+}
+
+constexpr CardMask cardBit(CardIndex card)
+{
+    return CardMask(1) << card;
+}
+
+constexpr bool hasCard(CardMask cards, CardIndex card)
+{
+    return (cards & cardBit(card)) != 0;
+}
+
+constexpr int cardCount(CardMask cards)
+{
+    return std::popcount(cards);
+}
+
+// Lowest card in a non-empty mask; pair with popLowestCard to walk a mask
+constexpr CardIndex lowestCard(CardMask cards)
+{
+    return CardIndex(std::countr_zero(cards));
+}
+
+constexpr CardMask popLowestCard(CardMask cards)
+{
+    return cards & (cards - 1);
+}
+
+// 13-bit rank mask of one suit (bit 0 = deuce)
+constexpr unsigned suitRanks(CardMask cards, int suit)
+{
+    return unsigned(cards >> (16 * suit)) & 0x1FFF;
+}
+
+// i-th card of an unshuffled deck, suit by suit
+constexpr CardIndex deckCard(int i)
+{
+    return CardIndex((i / 13) << 4 | (i % 13));
+}
+
+template <typename Range>
+constexpr CardMask maskOf(const Range &cards)
+{
+    CardMask mask = 0;
+    for (CardIndex card : cards)
+        mask |= cardBit(card);
+    return mask;
+}
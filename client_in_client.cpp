@@ -7,7 +7,7 @@ PokerClient::ClientState PokerClient::getClientStateCopy()
     return state;
 }
 
-PokerClient::PokerClient() : socket(io), running(false)
+PokerClient::PokerClient() : connection(io), running(false)
 {
 }
 void PokerClient::Init(Images suitTextures[4], Images *gameImages, Font *cardFont)
@@ -20,22 +20,20 @@ void PokerClient::Init(Images suitTextures[4], Images *gameImages, Font *cardFon
 PokerClient::~PokerClient()
 {
     stop();
+    if (equityThread.joinable())
+        equityThread.join();
 }
-void PokerClient::connect_to(const string &host, const string &port)
+void PokerClient::connect_to(const string &host, const string &port, bool useBinary)
 {
-    tcp::resolver resolver(io);
-    auto endpoints = resolver.resolve(host, port);
-    boost::asio::connect(socket, endpoints);
+    connection.connect_to(host, port, useBinary);
     cout << "Connected to server!\n";
+    if (useBinary)
+        cout << "Using the " << (connection.uses_binary() ? "binary" : "text") << " protocol\n";
 }
 
 void PokerClient::join_us(const string &name)
 {
-    MessageClientToServer join;
-    join.type = MessageTypeClientToServer::Join;
-    join.name = name;
-
-    write_line(serialize_client(join));
+    send(ToServer::Join{name});
 }
 
 void PokerClient::start()
@@ -48,26 +46,17 @@ void PokerClient::start()
 
 void PokerClient::sendReady()
 {
-    MessageClientToServer msg;
-    msg.type = MessageTypeClientToServer::Ready;
-
-    write_line(serialize_client(msg));
+    send(ToServer::Ready{});
 }
 
 void PokerClient::requestState()
 {
-    MessageClientToServer msg;
-    msg.type = MessageTypeClientToServer::RequestState;
-
-    write_line(serialize_client(msg));
+    send(ToServer::RequestState{});
 }
 
 void PokerClient::leaveGame()
 {
-    MessageClientToServer msg;
-    msg.type = MessageTypeClientToServer::Leave;
-
-    write_line(serialize_client(msg));
+    send(ToServer::Leave{});
     stop();
 }
 
@@ -80,28 +69,57 @@ void PokerClient::sendAction(PlayerActionType action, int amount)
         return;
     }
 
-    MessageClientToServer msg;
-    msg.type = MessageTypeClientToServer::Action;
-    msg.action = action;
-    msg.actionAmount = amount;
-
-    write_line(serialize_client(msg));
+    send(ToServer::Action{action, amount});
 }
 
 void PokerClient::startGame()
 {
-    MessageClientToServer msg;
-    msg.type = MessageTypeClientToServer::AdminPlay;
-    write_line(serialize_client(msg));
+    send(ToServer::AdminPlay{});
 }
 
 void PokerClient::sendChat(const string &chat)
 {
-    MessageClientToServer msg;
-    msg.type = MessageTypeClientToServer::Chat;
-    msg.chatText = chat;
+    send(ToServer::Chat{chat});
+}
 
-    write_line(serialize_client(msg));
+void PokerClient::estimateEquity(uint64_t samples)
+{
+    if (estimating.exchange(true))
+        return;
+
+    EquityRequest request;
+    {
+        lock_guard<mutex> lock(stateMutex);
+        request.players.push_back(state.myHand);
+        size_t opponents = state.inHand.size() - state.inHand.count(state.myId);
+        request.players.resize(1 + max<size_t>(1, opponents), hand{NoCard, NoCard});
+        request.board = state.board;
+    }
+    request.maxSamples = samples;
+
+    // The last estimate is done (estimating was false), its thread just hasn't been joined
+    if (equityThread.joinable())
+        equityThread.join();
+    if (!equityPool)
+        equityPool = make_unique<ThreadPool>();
+    equityThread = thread([this, request]()
+                          {
+                              double equity = -1;
+                              try
+                              {
+                                  equity = calculateEquity(*equityPool, request).equity[0];
+                              }
+                              catch (const invalid_argument &e)
+                              {
+                                  cout << "Can't estimate equity: " << e.what() << "\n";
+                              }
+                              {
+                                  // Dropped if the cards moved on while it ran
+                                  lock_guard<mutex> lock(stateMutex);
+                                  if (state.myHand == request.players[0] && state.board == request.board)
+                                      state.myEquity = equity;
+                              }
+                              estimating = false; });
 }
 
 void PokerClient::stop()
@@ -111,57 +129,54 @@ void PokerClient::stop()
     {
         return;
     }
-    boost::system::error_code ec;
-
-    socket.close(ec);
+    connection.close();
     if (readerThread.joinable())
     {
         readerThread.join();
     }
 }
 
-void PokerClient::UpdateMoney(const MessageServerToClient &msg)
+// Amounts come off the wire; a bogus one mustn't overflow a balance
+static int addMoney(int money, long long change)
+{
+    return int(clamp<long long>(money + change, numeric_limits<int>::min(), numeric_limits<int>::max()));
+}
+
+void PokerClient::UpdateMoney(const ToClient::ActionResult &msg)
 {
     switch (msg.action)
     {
     case PlayerActionType::Call:
-        state.playerMoney[msg.playerId] -= state.toCall;
+        state.playerMoney[msg.playerId] = addMoney(state.playerMoney[msg.playerId], -(long long)state.toCall);
         break;
     case PlayerActionType::Raise:
-        state.playerMoney[msg.playerId] -= msg.actionAmount;
+        state.playerMoney[msg.playerId] = addMoney(state.playerMoney[msg.playerId], -(long long)msg.amount);
         break;
     default:
         break;
     }
 }
 
-void PokerClient::write_line(const string &s)
+void PokerClient::send(const MessageClientToServer &msg)
 {
-    boost::asio::write(socket, boost::asio::buffer(s));
+    // The reader thread sends too (roster resync), hence the lock
+    lock_guard<mutex> lock(sendMutex);
+    connection.send(msg);
 }
+
 void PokerClient::readerLoop()
 {
-    boost::asio::streambuf buf;
-
-    while (running)
+    // Everything the socket delivers comes out of the connection's buffer a message at a time
+    string_view message;
+    while (running && connection.read(message))
     {
-        boost::system::error_code ec;
-
-        boost::asio::read_until(socket, buf, '\n', ec);
-
-        if (ec)
-        {
-            if (running)
-                cout << "Disconnected.\n";
-            break;
-        }
-
-        istream is(&buf);
-        string line;
-        getline(is, line);
-
-        handle_line(line);
+        if (connection.uses_binary())
+            handle_frame(message);
+        else
+            handle_line(message);
     }
+    if (running)
+        cout << "Disconnected.\n";
 }
 
 string PokerClient::nameOf(int id)
@@ -178,122 +193,230 @@ std::string PokerClient::nameOfUnsafe(int id)
     return "ID:  " + to_string(id);
 }
 
-void PokerClient::handle_line(const string &line)
+void PokerClient::handle_line(string_view line)
+{
+    MessageServerToClient msg;
+    ParseError error = parse_server(line, msg);
+    if (error == ParseError::Empty)
+        return;
+    if (error != ParseError::None)
+    {
+        cout << "Ignoring a malformed line from the server (" << parse_error_name(error) << "): " << strip_line_end(line) << "\n";
+        return;
+    }
+    handle_message(msg);
+}
+
+void PokerClient::handle_frame(string_view body)
+{
+    MessageServerToClient msg;
+    if (!decode_server_binary(body, msg))
+    {
+        cout << "Dropped a malformed frame of " << body.size() << " bytes.\n";
+        return;
+    }
+    handle_message(msg);
+}
+
+void PokerClient::handle_message(const MessageServerToClient &msg)
 {
     lock_guard<std::mutex> lock(stateMutex);
-    MessageServerToClient msg = deserialize_server(line);
-    switch (msg.type)
+    std::visit([this](const auto &m)
+               { on(m); },
+               msg);
+}
+
+void PokerClient::addPlayer(int id, string_view name)
+{
+    if (PlayerPosition.find(id) == PlayerPosition.end() && nextAvailablePosition < int(playerCardPositions.size()))
+        PlayerPosition[id] = playerCardPositions[nextAvailablePosition++];
+    state.playerNames[id] = string(name);
+}
+
+bool PokerClient::acceptRosterDelta(int version)
+{
+    if (rosterVersion < 0 || version <= rosterVersion)
+        return false; // Not joined yet, or the snapshot already has it
+    if (version != rosterVersion + 1)
     {
-    case MessageTypeServerToClient::Welcome:
-        cout << "Welcome, " << msg.name << "! Your player ID is " << msg.playerId << ". There are " << msg.playerSum << " players in the game.\n";
-        for (int i = 0; i < msg.playerSum; i++)
-        {
-            cout << "Player " << msg.playerNames[i] << " (ID: " << i << ") is in the game.";
-            PlayerPosition[i] = playerCardPositions[nextAvailablePosition++];
-            if (msg.playerMoney.find(i) != msg.playerMoney.end())
-                state.playerMoney[i] = msg.playerMoney[i]; // Initialize player money, can be updated later with actual values from the server
-            if (i == msg.playerId)
-                cout
-                    << " (You)";
-            if (msg.playerNames.find(i) != msg.playerNames.end())
-                state.playerNames[i] = msg.playerNames[i];
-            cout << "\n";
-        }
-        state.myId = msg.playerId;
-        break;
-    case MessageTypeServerToClient::PlayerJoined:
-        cout << "Player joined: " << msg.name << " (ID: " << msg.playerId << ")\n";
-        state.playerNames[msg.playerId] = msg.name;
+        // Missed a change somewhere; apply this one and get the whole roster again
+        cout << "Roster out of sync (have version " << rosterVersion << ", got " << version << "), asking for a snapshot.\n";
+        send(ToServer::RequestRoster{});
+    }
+    rosterVersion = version;
+    return true;
+}
+
+void PokerClient::on(const ToClient::Welcome &msg)
+{
+    cout << "Welcome, " << msg.name << "! Your player ID is " << msg.playerId << ".\n";
+    state.myId = msg.playerId;
+}
+
+void PokerClient::on(const ToClient::Roster &msg)
+{
+    if (msg.offset == 0)
+    {
+        // A new snapshot replaces whatever we had; seats keep their screen positions
+        state.playerNames.clear();
+        state.playerMoney.clear();
+    }
+    rosterVersion = msg.version;
+    for (const auto &player : msg.players)
+    {
+        cout << "Player " << player.name << " (ID: " << player.playerId << ") is in the game." << (player.playerId == state.myId ? " (You)" : "") << "\n";
+        addPlayer(player.playerId, player.name);
+        state.playerMoney[player.playerId] = player.money;
+    }
+}
+
+void PokerClient::on(const ToClient::PlayerJoined &msg)
+{
+    if (!acceptRosterDelta(msg.version))
+        return;
+    cout << "Player joined: " << msg.name << " (ID: " << msg.playerId << ")\n";
+    if (state.playerMoney.find(msg.playerId) == state.playerMoney.end())
         state.playerMoney[msg.playerId] = 1000; // Initialize player money for the new player
-        PlayerPosition[msg.playerId] = playerCardPositions[nextAvailablePosition++];
-        break;
-    case MessageTypeServerToClient::PlayerLeft:
-        cout << "Player left: " << nameOfUnsafe(msg.playerId) << "\n";
-        state.playerNames.erase(msg.playerId);
-        state.playerMoney.erase(msg.playerId); // Remove player money for the player who left
-        break;
-    case MessageTypeServerToClient::PlayerReady:
-        cout << "Player ready: " << nameOfUnsafe(msg.playerId) << "\n";
-        break;
-    case MessageTypeServerToClient::ChatFrom:
-        cout << nameOfUnsafe(msg.playerId) << ": " << msg.chatText << "\n";
-        break;
-    case MessageTypeServerToClient::GameState:
-        cout << "Game state changed: " << int(msg.gameState) << "\n";
-        state.gameState = msg.gameState;
-        break;
-    case MessageTypeServerToClient::ActionResult:
-        cout << "Action result for player " << nameOfUnsafe(msg.playerId) << ": " << int(msg.action) << "\n";
-        UpdateMoney(msg); // Update player money based on the action result
-        break;
-    case MessageTypeServerToClient::CommunityCard:
-        cout << "Community cards updated: " << msg.cards << "\n";
+    addPlayer(msg.playerId, msg.name);
+}
 
-        break;
-    case MessageTypeServerToClient::PlayerHand:
+void PokerClient::on(const ToClient::PlayerLeft &msg)
+{
+    if (!acceptRosterDelta(msg.version))
+        return;
+    cout << "Player left: " << nameOfUnsafe(msg.playerId) << "\n";
+    state.playerNames.erase(msg.playerId);
+    state.inHand.erase(msg.playerId);
+    state.playerMoney.erase(msg.playerId); // Remove player money for the player who left
+}
+
+void PokerClient::on(const ToClient::PlayerReady &msg)
+{
+    cout << "Player ready: " << nameOfUnsafe(msg.playerId) << "\n";
+}
+
+void PokerClient::on(const ToClient::ChatFrom &msg)
+{
+    cout << nameOfUnsafe(msg.playerId) << ": " << msg.text << "\n";
+}
+
+void PokerClient::on(const ToClient::GameState &msg)
+{
+    cout << "Game state changed: " << int(msg.state) << "\n";
+    state.gameState = msg.state;
+    if (msg.state == GameState::PreFlop)
+    {
+        state.board.clear();
+        state.myHand = {NoCard, NoCard};
+        state.madeHand = {};
+        state.allInEquity = -1;
+        state.myEquity = -1;
+        state.inHand.clear();
+    }
+}
+
+void PokerClient::on(const ToClient::ActionResult &msg)
+{
+    cout << "Action result for player " << nameOfUnsafe(msg.playerId) << ": " << int(msg.action) << "\n";
+    UpdateMoney(msg); // Update player money based on the action result
+    if (msg.action == PlayerActionType::Fold)
+        state.inHand.erase(msg.playerId);
+}
+
+void PokerClient::on(const ToClient::CommunityCard &msg)
+{
+    cout << "Community cards updated: " << cardValue(msg.card) << "." << cardSuit(msg.card) << "\n";
+    if (msg.card != NoCard)
     {
-        auto temp = make_card(msg);
-        if (msg.playerId == state.myId)
-        {
-            cout << "Your hand: " << msg.cards << "\n";
-            state.myCards.push_back(temp);
-        }
+        state.board.push_back(msg.card);
+        state.madeHand.add(msg.card);
+        state.myEquity = -1; // For the old board
+    }
+}
+
+void PokerClient::on(const ToClient::PlayerHand &msg)
+{
+    if (msg.card == NoCard)
+    {
+        cout << "Received an invalid card.\n";
+        return;
+    }
+    auto temp = make_card(msg.playerId, msg.card);
+    state.inHand.insert(msg.playerId);
+    if (msg.playerId == state.myId)
+    {
+        cout << "Your hand: " << cardValue(msg.card) << "." << cardSuit(msg.card) << "\n";
+        if (state.myHand.first == NoCard)
+            state.myHand.first = msg.card;
         else
-        {
-            cout << nameOfUnsafe(msg.playerId) << "'s hand updated.\n";
+            state.myHand.second = msg.card;
+        state.madeHand.add(msg.card);
+        state.myCards.push_back(temp);
+    }
+    else
+    {
+        cout << nameOfUnsafe(msg.playerId) << "'s hand updated.\n";
 
-            state.opponentCards.push_back(temp);
-        }
-        break;
+        state.opponentCards.push_back(temp);
     }
-    case MessageTypeServerToClient::PotUpdate:
-        cout << "Pot updated: $" << msg.potAmount << "\n";
-        break;
-    case MessageTypeServerToClient::Showdown:
-        cout << "Showdown! Pot: $" << msg.potAmount << ". Winners: ";
-        for (int id : msg.idWinners)
-        {
-            cout << nameOfUnsafe(id) << " (ID: " << id << ") \n";
-            state.playerMoney[id] += msg.potAmount / msg.idWinners.size(); // Distribute pot among winners
-        }
-        state.playerMoney[state.toAct] += msg.potAmount % msg.idWinners.size();
-        break;
-    case MessageTypeServerToClient::BettingUpdate:
-        cout << "Betting update: To Act: " << nameOfUnsafe(msg.toAct) << " (ID: " << msg.toAct << "), To Call: $" << msg.toCall << ", Current Bet: $" << msg.currentBet << ", Min Raise: $" << msg.minRaise << ", Pot: $" << msg.potAmount << "\n";
-        state.toAct = msg.toAct;           // Update the client state with the new player to act
-        state.toCall = msg.toCall;         // Update the client state with the new amount to call
-        state.currentBet = msg.currentBet; // Update the client state with the new current bet
-        state.minRaise = msg.minRaise;     // Update the client state with the new minimum raise
-        state.potAmount = msg.potAmount;   // Update the client state with the new pot amount
-        break;
-    default:
-        cout << "Unknown message type received.\n";
-        break;
+}
+
+void PokerClient::on(const ToClient::PotUpdate &msg)
+{
+    cout << "Pot updated: $" << msg.pot << "\n";
+}
+
+void PokerClient::on(const ToClient::Showdown &msg)
+{
+    // Side pots: the server says what each winner takes
+    cout << "Showdown! Pot: $" << msg.pot << ". Winners: ";
+    for (const auto &winner : msg.winners)
+    {
+        cout << nameOfUnsafe(winner.playerId) << " (ID: " << winner.playerId << ") wins $" << winner.amount << "\n";
+        state.playerMoney[winner.playerId] = addMoney(state.playerMoney[winner.playerId], winner.amount);
     }
 }
 
-Card PokerClient::make_card(const MessageServerToClient &msg)
+void PokerClient::on(const ToClient::BettingUpdate &msg)
 {
-    int value;
-    int suit;
+    cout << "Betting update: To Act: " << nameOfUnsafe(msg.toAct) << " (ID: " << msg.toAct << "), To Call: $" << msg.toCall << ", Current Bet: $" << msg.currentBet << ", Min Raise: $" << msg.minRaise << ", Pot: $" << msg.pot << "\n";
+    state.toAct = msg.toAct;           // Update the client state with the new player to act
+    state.toCall = msg.toCall;         // Update the client state with the new amount to call
+    state.currentBet = msg.currentBet; // Update the client state with the new current bet
+    state.minRaise = msg.minRaise;     // Update the client state with the new minimum raise
+    state.potAmount = msg.pot;         // Update the client state with the new pot amount
+}
 
-    value = stoi(msg.cards.substr(0, msg.cards.find('.')));
-    suit = stoi(msg.cards.substr(msg.cards.find('.') + 1));
+void PokerClient::on(const ToClient::AllInEquity &msg)
+{
+    cout << "All-in equity:";
+    for (const auto &[id, equity] : msg.players)
+    {
+        cout << " " << nameOfUnsafe(id) << " " << equity / 10.0 << "%";
+        if (id == state.myId)
+            state.allInEquity = equity;
+    }
+    cout << "\n";
+}
+
+Card PokerClient::make_card(int playerId, CardIndex cardIndex)
+{
+    valRank card = toValRank(cardIndex);
 
-    int x = PlayerPosition[msg.playerId].x;
-    int y = PlayerPosition[msg.playerId].y;
+    int x = PlayerPosition[playerId].x;
+    int y = PlayerPosition[playerId].y;
 
-    if (firstCard[msg.playerId])
+    if (firstCard[playerId])
     {
-        firstCard[msg.playerId] = false;
+        firstCard[playerId] = false;
         x += 20;
     }
     else
     {
-        firstCard[msg.playerId] = true;
+        firstCard[playerId] = true;
     }
 
-    auto temp = Card(x, y, valRank{value, suit}, suitTextures[suit], cardFont, gameImages);
+    auto temp = Card(x, y, card, suitTextures[card.suit], cardFont, gameImages);
 
     return temp;
 }
@@ -1,6 +1,10 @@
 #pragma once
 #include "poker_networking.hpp"
+#include "binary_protocol.hpp"
+#include "connection.hpp"
 #include "cards.h"
+#include "equity.hpp"
+#include "hand_eval.hpp"
 
 class PokerClient
 {
@@ -9,7 +13,7 @@ public:
 
     ~PokerClient();
 
-    void connect_to(const std::string &host, const std::string &port);
+    void connect_to(const std::string &host, const std::string &port, bool useBinary = true); // useBinary: ask for frames, see binary_protocol.hpp
     void join_us(const std::string &name);
     void start();
     void stop();
@@ -21,6 +25,9 @@ public:
     void startGame();
     void sendChat(const std::string &chat);
     void Init(Images suitTextures[4], Images *gameImages, Font *cardFont);
+    // Starts a Monte Carlo estimate of my hand against the other players still in the hand and
+    // returns at once; the result shows up in ClientState::myEquity. Ignored while one is running.
+    void estimateEquity(std::uint64_t samples = 20000);
 
     std::string nameOf(int id);
     std::string nameOfUnsafe(int id);
@@ -36,7 +43,12 @@ public:
         std::vector<Card> communityCards;
         std::vector<Card> myCards;
         std::vector<Card> opponentCards;
-        hand myHand;
+        std::vector<CardIndex> board;
+        hand myHand{NoCard, NoCard};
+        IncrementalHand madeHand; // My hole cards plus the board, extended as each card arrives
+        int allInEquity = -1; // Tenths of a percent, -1 until the server sends it
+        double myEquity = -1; // From estimateEquity, -1 until one finishes for the current cards
+        std::unordered_set<int> inHand; // Players dealt into this hand who haven't folded
         int toAct = -1;
         int toCall = 0;
         int currentBet = 0;
@@ -45,23 +57,52 @@ public:
     ClientState getClientStateCopy();
 
 private:
+    friend struct ClientFuzzer; // tools/protocol_fuzz.cpp feeds the handlers directly
+
     boost::asio::io_context io;
-    tcp::socket socket;
+    Connection connection;
 
     ClientState state;
     std::mutex stateMutex;
 
+    std::mutex sendMutex;
+    int rosterVersion = -1; // Of the roster in state, -1 until the first snapshot
+
     std::atomic<bool> running;
     std::thread readerThread;
 
-    void UpdateMoney(const MessageServerToClient &msg);
+    std::unique_ptr<ThreadPool> equityPool; // Started by the first estimate, so a client that never asks runs no workers
+    std::thread equityThread; // Drives the pool for one estimate (runOnAll can't be called from a pool task)
+    std::atomic<bool> estimating{false};
 
-    void write_line(const std::string &s);
-    void readerLoop();
+    void UpdateMoney(const ToClient::ActionResult &msg);
 
-    void handle_line(const std::string &line);
+    void send(const MessageClientToServer &msg);
+    void readerLoop();
 
-    Card make_card(const MessageServerToClient &msg);
+    void handle_line(std::string_view line);
+    void handle_frame(std::string_view body);
+    void handle_message(const MessageServerToClient &msg); // Strings in msg are only valid during the call
+
+    // One handler per message, called with stateMutex held
+    void on(const ToClient::Welcome &msg);
+    void on(const ToClient::PlayerJoined &msg);
+    void on(const ToClient::PlayerLeft &msg);
+    void on(const ToClient::PlayerReady &msg);
+    void on(const ToClient::ChatFrom &msg);
+    void on(const ToClient::GameState &msg);
+    void on(const ToClient::ActionResult &msg);
+    void on(const ToClient::BettingUpdate &msg);
+    void on(const ToClient::CommunityCard &msg);
+    void on(const ToClient::PlayerHand &msg);
+    void on(const ToClient::PotUpdate &msg);
+    void on(const ToClient::Showdown &msg);
+    void on(const ToClient::AllInEquity &msg);
+    void on(const ToClient::Roster &msg);
+    void addPlayer(int id, std::string_view name);
+    bool acceptRosterDelta(int version); // False if the delta is already in our roster
+
+    Card make_card(int playerId, CardIndex card);
 
     struct pos
     {
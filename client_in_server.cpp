@@ -1,13 +1,15 @@
 #include "client_in_server.hpp"
+#include <cctype>
+#include <span>
 using namespace std;
 
-void ServerState::send_to(const string &msg, int id)
+void ServerState::send_to(const MessageServerToClient &msg, int id)
 {
     auto target = find_if(clients.begin(), clients.end(),
                           [id](const shared_ptr<Client> &c)
                           { return c->id == id; });
     if (target != clients.end())
-        (*target)->send(make_shared<string>(msg));
+        (*target)->send(msg);
 }
 
 bool ServerState::all_ready() const
@@ -30,16 +32,80 @@ void ServerState::reset_game()
     }
 }
 
-void ServerState::broadcast_all(const string &msg)
+shared_ptr<string> ServerState::acquire_buffer()
+{
+    if (spareBuffers.empty())
+        return make_shared<string>();
+    auto buf = std::move(spareBuffers.back());
+    spareBuffers.pop_back();
+    buf->clear();
+    return buf;
+}
+
+void ServerState::release_buffer(shared_ptr<const string> buf)
+{
+    // Don't hoard: a bounded number of buffers, and none that grew for an unusually big message.
+    // Every buffer started out non-const in acquire_buffer, so handing it out for writing again is fine.
+    if (buf.use_count() == 1 && buf->capacity() <= 4096 && spareBuffers.size() < 256)
+        spareBuffers.push_back(const_pointer_cast<string>(std::move(buf)));
+}
+
+shared_ptr<const string> ServerState::encode(const MessageServerToClient &msg, bool binary)
+{
+    auto buf = acquire_buffer();
+    if (binary)
+    {
+        if (!encode_server_binary(msg, *buf))
+            cout << "Dropped a message of type " << int(messageType(msg)) << " too big for a frame\n";
+    }
+    else
+        serialize_server(msg, *buf);
+    return buf;
+}
+
+void ServerState::add_player(int id, const string &name)
+{
+    auto &stored = idToName[id] = name;
+    idToMoney[id] = 1000; // Give each player 1000 money when they join
+    broadcast_all(ToClient::PlayerJoined{++rosterVersion, id, stored});
+}
+
+void ServerState::remove_player(int id)
+{
+    if (idToName.erase(id) == 0)
+        return;
+    idToMoney.erase(id);
+    broadcast_all(ToClient::PlayerLeft{++rosterVersion, id});
+}
+
+void ServerState::disconnect(const shared_ptr<Client> &client)
+{
+    clients.erase(client);
+    remove_player(client->id);
+}
+
+void ServerState::flush()
 {
     for (auto &client : clients)
     {
-        client->send(make_shared<string>(msg));
+        client->flush();
+    }
+}
+
+void ServerState::broadcast_all(const MessageServerToClient &msg)
+{
+    shared_ptr<const string> encoded[2]; // Text, binary; only what the table actually uses
+    for (auto &client : clients)
+    {
+        auto &buf = encoded[client->uses_binary()];
+        if (!buf)
+            buf = encode(msg, client->uses_binary());
+        client->send(buf);
     }
 }
 
 Client::Client(tcp::socket s, ServerState *state)
-    : socket(move(s)), serverState(state)
+    : socket(move(s)), inbuf(MaxBuffered), serverState(state)
 {
     ready = false;
     inHand = false;
@@ -68,159 +134,285 @@ void Client::read_line()
         socket,
         inbuf,
         '\n',
-        [this, self](boost::system::error_code ec, size_t)
+        [this, self](boost::system::error_code ec, size_t length)
         {
             if (ec)
             {
                 cout << "[" << display_name() << "]" << ec.message() << " disconnected\n";
-                serverState->clients.erase(self);
+                serverState->disconnect(self);
                 return;
             }
 
-            istream is(&inbuf);
-            string line;
-            getline(is, line);
-            trim(line);
+            // Parsed in place, then dropped from the buffer (which may already hold the next lines)
+            string_view line(static_cast<const char *>(inbuf.data().data()), length);
+            if (strip_line_end(line) == BinaryHello)
+            {
+                inbuf.consume(length);
+                // Acknowledge in text, everything after this goes both ways as frames
+                send(make_shared<string>(string(BinaryHello) + "\n"));
+                binary = true;
+                cout << "[" << display_name() << "] switched to the binary protocol\n";
+                read_frame();
+                return;
+            }
 
-            handle_line(line);
+            {
+                EventBatch event(*serverState);
+                handle_line(line);
+            }
+            inbuf.consume(length);
 
             read_line();
         });
 }
 
-void Client::send(shared_ptr<string> msg)
+void Client::read_frame()
+{
+    auto self = shared_from_this();
+
+    // Handle every complete frame already buffered, as one event, then read exactly what the next
+    // one is missing
+    EventBatch event(*serverState);
+    size_t missing = 0;
+    while (true)
+    {
+        size_t have = inbuf.size();
+        const char *data = static_cast<const char *>(inbuf.data().data());
+        if (have < FrameHeaderSize)
+        {
+            missing = FrameHeaderSize - have;
+            break;
+        }
+        size_t body = frame_body_length(data);
+        if (have < FrameHeaderSize + body)
+        {
+            missing = FrameHeaderSize + body - have;
+            break;
+        }
+        handle_frame(string_view(data + FrameHeaderSize, body));
+        inbuf.consume(FrameHeaderSize + body);
+    }
+
+    boost::asio::async_read(
+        socket,
+        inbuf,
+        boost::asio::transfer_exactly(missing),
+        [this, self](boost::system::error_code ec, size_t)
+        {
+            if (ec)
+            {
+                cout << "[" << display_name() << "]" << ec.message() << " disconnected\n";
+                serverState->disconnect(self);
+                return;
+            }
+            read_frame();
+        });
+}
+
+void Client::send(const MessageServerToClient &msg)
+{
+    send(serverState->encode(msg, binary));
+}
+
+void Client::send(shared_ptr<const string> msg)
 {
-    bool writing = !outbox.empty();
+    if (msg->empty())
+        return; // Didn't fit in a frame, see ServerState::encode
     outbox.push_back(std::move(msg));
 
-    if (!writing)
+    if (!serverState->holding_writes())
+    {
+        flush();
+    }
+}
+
+void Client::flush()
+{
+    if (inFlight == 0 && !outbox.empty())
     {
         do_write();
     }
 }
 
+// Caps for one gathered write: the iovec count a single writev takes, and enough bytes that one
+// slow client can't make us build a huge write
+static constexpr size_t MaxGatherBuffers = 64;
+static constexpr size_t MaxGatherBytes = 64 * 1024;
+
 void Client::do_write()
 {
     auto self = shared_from_this();
-    auto msg = outbox.front();
+
+    // Everything queued goes out in one write. The outbox keeps the buffers alive until it completes.
+    gathered.clear();
+    size_t bytes = 0;
+    for (const auto &msg : outbox)
+    {
+        if (gathered.size() == MaxGatherBuffers || (bytes > 0 && bytes + msg->size() > MaxGatherBytes))
+            break;
+        gathered.push_back(boost::asio::buffer(*msg));
+        bytes += msg->size();
+    }
+    inFlight = gathered.size();
 
     boost::asio::async_write(
         socket,
-        boost::asio::buffer(*msg),
-        [this, self, msg](boost::system::error_code ec, size_t)
+        span<const boost::asio::const_buffer>(gathered), // A view, so the write doesn't copy the vector
+        [this, self](boost::system::error_code ec, size_t)
         {
             if (ec)
             {
                 cout << "[" << display_name() << "] write error:" << ec.message() << "\n";
-                serverState->clients.erase(self);
+                serverState->disconnect(self);
                 return;
             }
 
-            outbox.pop_front();
-            if (!outbox.empty())
+            for (; inFlight > 0; inFlight--)
             {
-                do_write();
+                serverState->release_buffer(std::move(outbox.front()));
+                outbox.pop_front();
             }
+            flush();
         });
 }
 
-void Client::broadcast(const string &msg)
+void Client::broadcast(const MessageServerToClient &msg)
 {
-    auto buffer = make_shared<string>(msg);
-    for (auto &c : serverState->clients)
+    serverState->broadcast_all(msg);
+}
+
+void Client::send_to(const MessageServerToClient &msg, int id)
+{
+    serverState->send_to(msg, id);
+}
+
+void Client::handle_line(string_view line)
+{
+    ParseError error = parse_client(line, incoming);
+    if (error == ParseError::Empty)
+        return;
+    if (error != ParseError::None)
     {
-        c->send(buffer);
+        cout << "[" << display_name() << "] sent a malformed line (" << parse_error_name(error) << "): " << strip_line_end(line) << "\n";
+        return;
     }
+    handle_message(incoming);
 }
 
-void Client::send_to(const std::string &msg, int id)
+void Client::handle_frame(string_view body)
 {
-    auto target = find_if(serverState->clients.begin(), serverState->clients.end(),
-                          [id](const shared_ptr<Client> &c)
-                          { return c->id == id; });
-    if (target != serverState->clients.end())
-        (*target)->send(make_shared<string>(msg));
+    MessageClientToServer msg;
+    if (!decode_client_binary(body, msg))
+    {
+        cout << "[" << display_name() << "] sent a malformed frame of " << body.size() << " bytes\n";
+        return;
+    }
+    handle_message(msg);
+}
+
+// Names go out as one word in rosters
+static string playerName(string_view requested)
+{
+    string clean(requested);
+    for (char &c : clean)
+    {
+        if (isspace(static_cast<unsigned char>(c)))
+            c = '_';
+    }
+    return clean.empty() ? "Player" : clean;
 }
 
-void Client::handle_line(const string &line)
+void Client::send_roster()
 {
-    MessageClientToServer msg = deserialize_client(line);
-    MessageServerToClient response{};
-    bool validMessage = true;
-    switch (msg.type)
+    ToClient::Roster roster;
+    roster.version = serverState->rosterVersion;
+    for (const auto &client : serverState->clients)
     {
-    case MessageTypeClientToServer::Join:
-        name = msg.name;
-        this->id = serverState->nextId++;
-        serverState->idToName[id] = name;
-        serverState->idToMoney[id] = 1000; // Give each player 1000 money when they join
-        cout << "[" << display_name() << "] joined\n";
-
-        send(make_shared<string>(serialize_server(
-            MessageServerToClient{
-                .type = MessageTypeServerToClient::Welcome,
-                .playerId = id,
-                .playerSum = int(serverState->idToName.size()),
-                .name = name,
-                .playerNames = serverState->idToName,
-                .playerMoney = serverState->idToMoney})));
-
-        response.type = MessageTypeServerToClient::PlayerJoined;
-        response.playerId = id;
-        response.name = name;
-        break;
-    case MessageTypeClientToServer::Ready:
-        cout << "[" << display_name() << "] is ready\n";
-        ready = true;
-        response.type = MessageTypeServerToClient::PlayerReady;
-        response.playerId = id;
-        break;
-    case MessageTypeClientToServer::Chat:
-        cout << "[" << display_name() << "] says: " << msg.chatText << "\n";
-        response.type = MessageTypeServerToClient::ChatFrom;
-        response.chatText = msg.chatText;
-        response.playerId = id;
-        break;
-    case MessageTypeClientToServer::Action:
-        hasPendingAction = true;
-        PendingAction = line;
-        if (serverState->gameState == GameState::WaitingForPlayers || serverState->gameState == GameState::Showdown || serverState->toAct != id)
+        auto entry = serverState->idToName.find(client->id);
+        if (entry == serverState->idToName.end())
+            continue;
+        roster.players.push_back({client->id, client->money, entry->second});
+        if (roster.players.size() == RosterChunk)
         {
-            cout << "[" << display_name() << "] invalid action because " << "gameState=" << int(serverState->gameState) << " toAct=" << serverState->toAct << " myId=" << id << "\n";
-            validMessage = false;
-            break;
+            send(roster);
+            roster.offset += int(RosterChunk);
+            roster.players.clear();
         }
+    }
+    if (!roster.players.empty() || roster.offset == 0)
+        send(roster);
+}
 
-        cout << "[" << display_name() << "] action: " << int(msg.action) << " actionAmount: " << msg.actionAmount << "\n";
-        response.playerId = id;
-        response.action = msg.action;
-        response.actionAmount = msg.actionAmount;
-
-        if (on_action_ptr)
-            on_action_ptr(id, msg.action, msg.actionAmount);
-
-        validMessage = false; // Don't broadcast the action message to other clients, the server will broadcast the result after processing the action
-        break;
-    case MessageTypeClientToServer::RequestState:
-        cout << "[" << display_name() << "] requested game state\n";
-        response.type = MessageTypeServerToClient::GameState;
-        response.gameState = serverState->gameState;
-        break;
-    case MessageTypeClientToServer::Leave:
-        cout << "[" << display_name() << "] left\n";
-        response.type = MessageTypeServerToClient::PlayerLeft;
-        response.playerId = id;
-        break;
-    case MessageTypeClientToServer::AdminPlay:
-        cout << "[" << display_name() << "] triggered admin play\n";
-        if (play_game_ptr)
-            play_game_ptr();
-        validMessage = false; // Don't broadcast this message to other clients
-        break;
-    default:
-        validMessage = false;
-        break;
+void Client::handle_message(const MessageClientToServer &msg)
+{
+    visit([this](const auto &m)
+          { on(m); },
+          msg);
+}
+
+void Client::on(const ToServer::Join &msg)
+{
+    name = playerName(msg.name);
+    this->id = serverState->nextId++;
+    cout << "[" << display_name() << "] joined\n";
+
+    // Everyone else hears about it through the delta, which the snapshot here already includes
+    serverState->add_player(id, name);
+    send(ToClient::Welcome{id, name});
+    send_roster();
+}
+
+void Client::on(const ToServer::Ready &)
+{
+    cout << "[" << display_name() << "] is ready\n";
+    ready = true;
+    broadcast(ToClient::PlayerReady{id});
+}
+
+void Client::on(const ToServer::Chat &msg)
+{
+    cout << "[" << display_name() << "] says: " << msg.text << "\n";
+    broadcast(ToClient::ChatFrom{id, msg.text});
+}
+
+void Client::on(const ToServer::Action &msg)
+{
+    hasPendingAction = true;
+    PendingAction.clear();
+    serialize_client(msg, PendingAction);
+    if (serverState->gameState == GameState::WaitingForPlayers || serverState->gameState == GameState::Showdown || serverState->toAct != id)
+    {
+        cout << "[" << display_name() << "] invalid action because " << "gameState=" << int(serverState->gameState) << " toAct=" << serverState->toAct << " myId=" << id << "\n";
+        return;
     }
-    if (validMessage)
-        broadcast(serialize_server(response));
+
+    cout << "[" << display_name() << "] action: " << int(msg.action) << " actionAmount: " << msg.amount << "\n";
+
+    // Not broadcast, the server broadcasts the result after processing the action
+    if (on_action_ptr)
+        on_action_ptr(id, msg.action, msg.amount);
+}
+
+void Client::on(const ToServer::RequestState &)
+{
+    cout << "[" << display_name() << "] requested game state\n";
+    broadcast(ToClient::GameState{serverState->gameState, serverState->pot});
+}
+
+void Client::on(const ToServer::Leave &)
+{
+    cout << "[" << display_name() << "] left\n";
+    serverState->remove_player(id);
+}
+
+void Client::on(const ToServer::AdminPlay &)
+{
+    cout << "[" << display_name() << "] triggered admin play\n";
+    if (play_game_ptr)
+        play_game_ptr();
+}
+
+void Client::on(const ToServer::RequestRoster &)
+{
+    send_roster();
 }
@@ -1,16 +1,21 @@
 #pragma once
 #include "poker_networking.hpp"
+#include "binary_protocol.hpp"
 #include "visual.hpp"
+#include "equity.hpp"
+#include "showdown.hpp"
 
 class Client;
 
 struct HandState
 {
     bool active = false;
+    int handId = 0; // Bumped every deal so late async results for an old hand can be dropped
 
     std::vector<int> playersOrderd;
     std::vector<hand> hole;
-    std::vector<valRank> communityCards;
+    std::vector<int> committed; // Chips each seat put in this hand, indexed like hole
+    std::vector<CardIndex> communityCards;
 
     int street = 0; // 0: PreFlop, 1: Flop, 2: Turn, 3: River
 
@@ -19,6 +24,7 @@ struct HandState
         active = false;
         playersOrderd.clear();
         hole.clear();
+        committed.clear();
         communityCards.clear();
     }
 };
@@ -42,26 +48,75 @@ struct ServerState
     std::unordered_map<int, std::string> idToName;
     std::unordered_map<int, int> idToMoney;
 
+    // The lobby roster (idToName) is versioned. Every join or leave bumps rosterVersion and goes to
+    // everyone as a single PlayerJoined/PlayerLeft carrying it, so a change costs O(1) per client
+    // whatever the lobby size; only a joining player gets the whole roster, once (Client::send_roster).
+    int rosterVersion = 0;
+
+    void add_player(int id, const std::string &name);
+    void remove_player(int id);                          // No-op if id isn't on the roster
+    void disconnect(const std::shared_ptr<Client> &client); // Drops the connection and its roster entry
+
     GameState gameState = GameState::WaitingForPlayers;
 
-    void broadcast_all(const std::string &msg);
+    // Encoded messages are pooled buffers, immutable once encoded so any number of outboxes can
+    // share one. When the last outbox lets go a buffer comes back here with its capacity, so in
+    // steady state encoding allocates nothing.
+    std::vector<std::shared_ptr<std::string>> spareBuffers;
+
+    std::shared_ptr<std::string> acquire_buffer();              // Empty, but usually with capacity
+    void release_buffer(std::shared_ptr<const std::string> buf); // Kept only if nothing else holds it
+    std::shared_ptr<const std::string> encode(const MessageServerToClient &msg, bool binary);
+
+    // Encodes msg once per protocol in use, every client's outbox then points at the same bytes
+    void broadcast_all(const MessageServerToClient &msg);
 
-    void send_to(const std::string &msg, int id);
+    // With flushPerEvent, messages sent while handling one game event (an incoming message, an
+    // equity result) only queue up, and each socket gets them all in one write when the event ends.
+    // Without it every send starts a write as soon as the socket is idle.
+    bool flushPerEvent = true;
+    int eventDepth = 0;
+
+    bool holding_writes() const { return flushPerEvent && eventDepth > 0; }
+    void flush();
+
+    void send_to(const MessageServerToClient &msg, int id);
 
     bool all_ready() const;
 
     void reset_game();
 };
 
+// Marks the scope of one game event, see ServerState::flushPerEvent. Nests.
+class EventBatch
+{
+public:
+    explicit EventBatch(ServerState &state) : state(state) { state.eventDepth++; }
+    ~EventBatch()
+    {
+        if (--state.eventDepth == 0)
+            state.flush();
+    }
+
+    EventBatch(const EventBatch &) = delete;
+    EventBatch &operator=(const EventBatch &) = delete;
+
+private:
+    ServerState &state;
+};
+
 class Client : public std::enable_shared_from_this<Client>
 {
 public:
     Client(tcp::socket s, ServerState *state);
 
     void start();
-    void broadcast(const std::string &msg);
-    void send_to(const std::string &msg, int id);
-    void send(std::shared_ptr<std::string> msg);
+    void broadcast(const MessageServerToClient &msg);
+    void send_to(const MessageServerToClient &msg, int id);
+    void send(const MessageServerToClient &msg); // Encoded for this client's protocol
+    void send(std::shared_ptr<const std::string> msg); // Already encoded bytes, possibly shared
+    bool uses_binary() const { return binary; }
+    void flush(); // Starts writing whatever is queued, if no write is in flight
 
     std::function<void()> play_game_ptr;
     std::string display_name() const;
@@ -78,17 +133,35 @@ public:
     int betThisRound = 0;
 
 private:
+    static constexpr std::size_t MaxBuffered = FrameHeaderSize + MaxFrameBody; // A longer line fails the read and drops the client
+
     tcp::socket socket;
     boost::asio::streambuf inbuf;
     ServerState *serverState;
 
     std::string name;
+    bool binary = false; // Switched to frames by the HELLO handshake, see binary_protocol.hpp
 
-    std::deque<std::shared_ptr<std::string>> outbox;
+    std::deque<std::shared_ptr<const std::string>> outbox;
+    std::vector<boost::asio::const_buffer> gathered; // The buffers of the write in flight, outbox[0, inFlight)
+    std::size_t inFlight = 0;
+    MessageClientToServer incoming{}; // Parse target for text lines, reused so parsing doesn't allocate
 
     void read_line();
+    void read_frame();
 
     void do_write();
 
-    void handle_line(const std::string &line);
+    void handle_line(std::string_view line);
+    void handle_frame(std::string_view body);
+    void handle_message(const MessageClientToServer &msg);
+    void on(const ToServer::Join &msg);
+    void on(const ToServer::Ready &msg);
+    void on(const ToServer::Chat &msg);
+    void on(const ToServer::Action &msg);
+    void on(const ToServer::RequestState &msg);
+    void on(const ToServer::Leave &msg);
+    void on(const ToServer::AdminPlay &msg);
+    void on(const ToServer::RequestRoster &msg);
+    void send_roster(); // Snapshot of the lobby at the current roster version
 };
\ No newline at end of file
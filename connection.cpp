@@ -0,0 +1,217 @@
+#include "connection.hpp"
+#include <cstring>
+using namespace std;
+
+Connection::Connection(boost::asio::io_context &io) : io(io), sock(io), inbuf(MaxBuffered)
+{
+}
+
+void Connection::connect_to(const string &host, const string &port, bool useBinary)
+{
+    tcp::resolver resolver(io);
+    auto endpoints = resolver.resolve(host, port);
+    boost::asio::connect(sock, endpoints);
+    if (!useBinary)
+        return;
+
+    // The server echoes the hello if it speaks frames. Anything else is an ordinary line, left in
+    // the buffer for the first read.
+    outbuf.append(BinaryHello).push_back('\n');
+    flush();
+    string_view line;
+    if (!read_for(line, HelloTimeout))
+    {
+        if (ec != boost::asio::error::timed_out)
+            throw boost::system::system_error(ec);
+        // No answer in time. A late echo would switch the server to frames while we still talked
+        // text, so this connection can't be trusted either way: start over on one that never asks.
+        close();
+        inbuf.consume(inbuf.size());
+        pending = 0;
+        ec = {};
+        boost::asio::connect(sock, endpoints);
+        return;
+    }
+    if (strip_line_end(line) == BinaryHello)
+        binary = true;
+    else
+        pending = 0;
+}
+
+void Connection::close()
+{
+    boost::system::error_code ignored;
+    sock.close(ignored);
+}
+
+bool Connection::take_buffered(string_view &message)
+{
+    inbuf.consume(pending);
+    pending = 0;
+    const char *data = static_cast<const char *>(inbuf.data().data());
+    size_t have = inbuf.size();
+    if (binary)
+    {
+        if (have < FrameHeaderSize || have - FrameHeaderSize < frame_body_length(data))
+            return false;
+        pending = FrameHeaderSize + frame_body_length(data);
+        message = string_view(data + FrameHeaderSize, pending - FrameHeaderSize);
+        return true;
+    }
+    const void *newline = have ? memchr(data, '\n', have) : nullptr;
+    if (!newline)
+        return false;
+    pending = size_t(static_cast<const char *>(newline) - data) + 1;
+    message = string_view(data, pending);
+    return true;
+}
+
+bool Connection::buffer_full()
+{
+    // Only a text line can get here, a frame always fits
+    if (inbuf.size() + ReadChunk <= MaxBuffered)
+        return false;
+    ec = boost::asio::error::message_size;
+    return true;
+}
+
+bool Connection::fill()
+{
+    if (buffer_full())
+        return false;
+    size_t n = sock.read_some(inbuf.prepare(ReadChunk), ec);
+    inbuf.commit(n);
+    return !ec;
+}
+
+bool Connection::fill_until(Clock::time_point deadline)
+{
+    if (buffer_full())
+        return false;
+    bool done = false;
+    sock.async_read_some(inbuf.prepare(ReadChunk), [&](const boost::system::error_code &error, size_t n)
+                         {
+                             inbuf.commit(n);
+                             ec = error;
+                             done = true; });
+    io.restart();
+    io.run_until(deadline);
+    if (!done)
+    {
+        // Out of time: cancel, and wait for the read to come back aborted
+        boost::system::error_code ignored;
+        sock.cancel(ignored);
+        io.restart();
+        while (!done && io.run_one())
+        {
+        }
+        if (ec == boost::asio::error::operation_aborted)
+            ec = boost::asio::error::timed_out;
+    }
+    return !ec;
+}
+
+bool Connection::read(string_view &message)
+{
+    while (!take_buffered(message))
+    {
+        if (!fill())
+            return false;
+    }
+    return true;
+}
+
+bool Connection::read_for(string_view &message, Clock::duration timeout)
+{
+    Clock::time_point deadline = Clock::now() + timeout;
+    while (!take_buffered(message))
+    {
+        if (!fill_until(deadline))
+            return false;
+    }
+    return true;
+}
+
+template <typename Variant>
+bool Connection::decode(string_view message, Variant &msg)
+{
+    bool ok = binary ? decode_binary(message, msg) : read_text(message, msg) == ParseError::None;
+    if (!ok)
+        ec = make_error_code(boost::system::errc::bad_message);
+    return ok;
+}
+
+template <typename Variant, typename Read>
+bool Connection::receive_with(Variant &msg, Read &&read)
+{
+    string_view message;
+    do
+    {
+        if (!read(message))
+            return false;
+    } while (!binary && strip_line_end(message).empty());
+    return decode(message, msg);
+}
+
+bool Connection::receive(MessageServerToClient &msg)
+{
+    return receive_with(msg, [this](string_view &message)
+                        { return read(message); });
+}
+
+bool Connection::receive(MessageClientToServer &msg)
+{
+    return receive_with(msg, [this](string_view &message)
+                        { return read(message); });
+}
+
+bool Connection::receive_for(MessageServerToClient &msg, Clock::duration timeout)
+{
+    Clock::time_point deadline = Clock::now() + timeout;
+    return receive_with(msg, [&](string_view &message)
+                        { return read_for(message, deadline - Clock::now()); });
+}
+
+bool Connection::receive_for(MessageClientToServer &msg, Clock::duration timeout)
+{
+    Clock::time_point deadline = Clock::now() + timeout;
+    return receive_with(msg, [&](string_view &message)
+                        { return read_for(message, deadline - Clock::now()); });
+}
+
+void Connection::queue(const MessageClientToServer &msg)
+{
+    if (!binary)
+        serialize_client(msg, outbuf);
+    else if (!encode_client_binary(msg, outbuf))
+        throw boost::system::system_error(boost::asio::error::message_size);
+}
+
+void Connection::queue(const MessageServerToClient &msg)
+{
+    if (!binary)
+        serialize_server(msg, outbuf);
+    else if (!encode_server_binary(msg, outbuf))
+        throw boost::system::system_error(boost::asio::error::message_size);
+}
+
+void Connection::flush()
+{
+    boost::system::error_code error;
+    boost::asio::write(sock, boost::asio::buffer(outbuf), error);
+    outbuf.clear(); // Sent or not, so a failed write doesn't leave half a message in front of the next
+    if (error)
+        throw boost::system::system_error(error);
+}
+
+void Connection::send(const MessageClientToServer &msg)
+{
+    queue(msg);
+    flush();
+}
+
+void Connection::send(const MessageServerToClient &msg)
+{
+    queue(msg);
+    flush();
+}
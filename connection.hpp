@@ -0,0 +1,119 @@
+#pragma once
+#include "poker_networking.hpp"
+#include "binary_protocol.hpp"
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+
+// One end of a protocol connection with its own receive buffer and write queue, for anything that
+// talks to the other side in order rather than through the server's event loop: the client, bots,
+// tools.
+//
+// Reads pull whatever the socket has into the buffer and hand out one message at a time, a line in
+// text mode or a frame body in binary, so messages that arrived together come out one by one and
+// nothing past the first is dropped. The message a read returns points into the buffer and stays
+// valid until the next read. Once the buffer and the write queue have grown to fit the traffic,
+// reading and sending allocate nothing.
+//
+// Reads come in three kinds: blocking, timed (which run the io_context for up to the timeout, so
+// nothing else may be running it at the time) and async. Only one read may be in progress at a
+// time. Sending can happen on another thread than reading, one sender at a time.
+//
+// A failed read returns false with the reason in error(): eof when the other side closed,
+// timed_out, message_size for a line that outgrew the buffer, bad_message for a message that
+// didn't decode. A failed send throws boost::system::system_error, like boost::asio::write.
+class Connection
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit Connection(boost::asio::io_context &io);
+
+    // Connects and, with useBinary, asks for frames (see binary_protocol.hpp). A server that doesn't
+    // answer within HelloTimeout gets a fresh connection that stays in text, so the two sides never
+    // disagree on the protocol; only servers from before the binary protocol pay that wait. Runs
+    // the io_context like the timed reads. Throws boost::system::system_error if it can't connect.
+    void connect_to(const std::string &host, const std::string &port, bool useBinary = true);
+    void close();
+
+    tcp::socket &socket() { return sock; } // E.g. to accept into
+    bool uses_binary() const { return binary; }
+    void set_binary(bool frames) { binary = frames; } // After the handshake, on an accepted connection
+    const boost::system::error_code &error() const { return ec; } // Of the last read
+
+    // The next message: a line with its line ending, or a frame body
+    bool read(std::string_view &message);
+    bool read_for(std::string_view &message, Clock::duration timeout);
+
+    // handler(const boost::system::error_code &, std::string_view message), called through the
+    // io_context, never from inside async_read
+    template <typename Handler>
+    void async_read(Handler handler);
+
+    // Reads and decodes the next message. Strings in msg point into the buffer, like read's message.
+    // Blank text lines are skipped.
+    bool receive(MessageServerToClient &msg);
+    bool receive(MessageClientToServer &msg);
+    bool receive_for(MessageServerToClient &msg, Clock::duration timeout);
+    bool receive_for(MessageClientToServer &msg, Clock::duration timeout);
+
+    // queue encodes into the write queue (throwing message_size for one too big for a frame),
+    // flush writes everything queued in one go
+    void queue(const MessageClientToServer &msg);
+    void queue(const MessageServerToClient &msg);
+    void flush();
+    void send(const MessageClientToServer &msg);
+    void send(const MessageServerToClient &msg);
+
+private:
+    static constexpr std::size_t ReadChunk = 4096;
+    static constexpr std::size_t MaxBuffered = 1 << 17; // Room for the biggest frame and then some
+    static constexpr std::chrono::milliseconds HelloTimeout{1000}; // Well over a round trip; missing it only costs a reconnect
+
+    boost::asio::io_context &io;
+    tcp::socket sock;
+    boost::asio::streambuf inbuf;
+    std::size_t pending = 0; // Bytes of the message last handed out, consumed by the next read
+    std::string outbuf; // The write queue
+    bool binary = false;
+    boost::system::error_code ec;
+
+    bool take_buffered(std::string_view &message); // A whole message already in inbuf
+    bool buffer_full();                            // Sets ec if no message can fit any more
+    bool fill();                                   // One read_some into inbuf
+    bool fill_until(Clock::time_point deadline);
+    template <typename Variant>
+    bool decode(std::string_view message, Variant &msg);
+    template <typename Variant, typename Read>
+    bool receive_with(Variant &msg, Read &&read);
+};
+
+template <typename Handler>
+void Connection::async_read(Handler handler)
+{
+    std::string_view message;
+    if (take_buffered(message))
+    {
+        boost::asio::post(io, [handler = std::move(handler), message]() mutable
+                          { handler(boost::system::error_code(), message); });
+        return;
+    }
+    if (buffer_full())
+    {
+        boost::asio::post(io, [handler = std::move(handler), error = ec]() mutable
+                          { handler(error, std::string_view()); });
+        return;
+    }
+    sock.async_read_some(inbuf.prepare(ReadChunk), [this, handler = std::move(handler)](const boost::system::error_code &error, std::size_t n) mutable
+                         {
+                             inbuf.commit(n);
+                             if (error)
+                             {
+                                 ec = error;
+                                 handler(error, std::string_view());
+                                 return;
+                             }
+                             async_read(std::move(handler)); });
+}
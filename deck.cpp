@@ -1,83 +1,129 @@
 #include "deck.h"
 
-Deck::Deck()
+Deck::Deck(CardMask composition) : Deck(composition, Xoshiro256(randomSeed()))
 {
-    srand(static_cast<unsigned>(time(nullptr)));
-    cards = RandomizeDeck();
 }
 
-vector<valRank> Deck::CreateDeck()
+Deck::Deck(CardMask composition, Xoshiro256 rng) : composition(composition & FullDeckMask), rng(rng)
 {
-    vector<valRank> tempDeck;
-    int rank, value;
-    for (int i = 0; i < 4; i++)
+    for (CardMask rest = this->composition; rest; rest = popLowestCard(rest))
     {
-        rank = i;
-        for (int j = 2; j <= 14; j++)
-        {
-            value = j;
-            tempDeck.push_back({value, rank});
-        }
+        Place(lowestCard(rest), size++);
     }
-    return tempDeck;
+    live = size;
 }
 
-vector<valRank> Deck::RandomizeDeck()
+void Deck::Place(CardIndex card, int at)
 {
-    vector<valRank> tempDeck;
-    tempDeck = CreateDeck();
-    for (int i = tempDeck.size() - 1; i > 0; i--)
-    {
-        int j = rand() % (i + 1);
-        swap(tempDeck[i], tempDeck[j]);
-    }
-    return tempDeck;
+    cards[at] = card;
+    position[card] = uint8_t(at);
+}
+
+void Deck::SetRng(Xoshiro256 generator)
+{
+    rng = generator;
+}
+
+void Deck::Reset()
+{
+    dealt = 0;
+    live = size;
+}
+
+bool Deck::RemoveCard(CardIndex card)
+{
+    if (!isValidCard(card) || !hasCard(composition, card))
+        return false;
+    int at = position[card];
+    if (at < dealt || at >= live)
+        return false;
+    live--;
+    Place(cards[live], at);
+    Place(card, live);
+    return true;
+}
+
+int Deck::Remaining() const
+{
+    return live - dealt;
 }
 
 void Deck::Draw()
 {
-    for (int i = 0; i < cards.size(); i++)
+    for (int i = dealt; i < live; i++)
     {
-        cout << cards[i].value << " " << cards[i].suit << endl;
+        cout << cardValue(cards[i]) << " " << cardSuit(cards[i]) << endl;
     }
 }
 
-valRank Deck::DrawCard()
+CardIndex Deck::DrawCard()
 {
-    if (cards.empty())
+    if (dealt == live)
     {
-        cards = RandomizeDeck();
+        Reset();
     }
-    valRank temp = cards[cards.size() - 1];
-    cards.pop_back();
-    return temp;
+    int pick = dealt + int(rng.bounded(uint32_t(live - dealt)));
+    CardIndex card = cards[pick];
+    Place(cards[dealt], pick);
+    Place(card, dealt);
+    dealt++;
+    return card;
 }
 
-void Deck::SaveDeck()
+DeckSnapshot Deck::Snapshot() const
 {
+    DeckSnapshot snapshot{};
+    snapshot.composition = composition;
+    auto state = rng.state();
+    for (int i = 0; i < 4; i++)
+        snapshot.rng[i] = state[i];
+    for (int i = 0; i < size; i++)
+        snapshot.cards[i] = cards[i];
+    snapshot.size = uint8_t(size);
+    snapshot.live = uint8_t(live);
+    snapshot.dealt = uint8_t(dealt);
+    return snapshot;
+}
 
-    ofstream fout("saves/deck.txt");
-    if (fout.is_open())
+bool Deck::Restore(const DeckSnapshot &snapshot)
+{
+    // The cards must be exactly the composition, each once
+    CardMask seen = 0;
+    if (snapshot.size > DeckSize || snapshot.live > snapshot.size || snapshot.dealt > snapshot.live)
+        return false;
+    for (int i = 0; i < snapshot.size; i++)
     {
-        for (auto &card : cards)
-        {
-            fout << card.value << " " << card.suit << endl;
-        }
+        CardIndex card = snapshot.cards[i];
+        if (!isValidCard(card) || hasCard(seen, card))
+            return false;
+        seen |= cardBit(card);
     }
-    fout.close();
+    if (seen != snapshot.composition)
+        return false;
+
+    composition = snapshot.composition;
+    rng = Xoshiro256::fromState({snapshot.rng[0], snapshot.rng[1], snapshot.rng[2], snapshot.rng[3]});
+    size = snapshot.size;
+    live = snapshot.live;
+    dealt = snapshot.dealt;
+    for (int i = 0; i < size; i++)
+        Place(snapshot.cards[i], i);
+    return true;
 }
 
-void Deck::LoadDeck()
+bool Deck::SaveDeck(const string &path) const
 {
-    ifstream fin("saves/deck.txt");
-    if (fin.is_open())
-    {
-        cards.clear();
-        valRank temp;
-        while (fin >> temp.value >> temp.suit)
-        {
-            cards.push_back(temp);
-        }
-    }
-    fin.close();
+    DeckSnapshot snapshot = Snapshot();
+    ofstream fout(path, ios::binary | ios::trunc);
+    fout.write(reinterpret_cast<const char *>(&snapshot), sizeof(snapshot));
+    return bool(fout);
+}
+
+bool Deck::LoadDeck(const string &path)
+{
+    DeckSnapshot snapshot;
+    ifstream fin(path, ios::binary);
+    if (!fin.read(reinterpret_cast<char *>(&snapshot), sizeof(snapshot)))
+        return false;
+    return Restore(snapshot);
 }
@@ -1,17 +1,36 @@
 #pragma once
 #include "visual.hpp"
+#include "rng.hpp"
+#include "snapshot.hpp"
 using namespace std;
 
+// Fixed-size deck shuffled lazily: each DrawCard does one Fisher-Yates step, picking uniformly
+// among the cards not dealt yet, so a hand only pays for the cards it uses and nothing allocates.
+// cards[0, dealt) are dealt, cards[dealt, live) can still come out and cards[live, size) are dead.
+// Any order of the undealt part is as good as a shuffled one, so Reset just moves the markers back.
 class Deck
 {
 private:
-    vector<valRank> cards; // The deck of cards
+    array<CardIndex, DeckSize> cards;  // Every card of the composition, see above for the layout
+    array<uint8_t, 64> position{};     // Where each card currently sits in cards
+    int size = 0;                      // Cards in the composition
+    int live = 0;                      // End of the cards that can still be dealt
+    int dealt = 0;
+    CardMask composition;    // Which cards the variant plays with
+    Xoshiro256 rng;          // This table's own stream, see rng.hpp
+
+    void Place(CardIndex card, int at);
 public:
-    Deck();
-    vector<valRank> CreateDeck();    // Creates a standard deck of 52 cards
-    vector<valRank> RandomizeDeck(); // Shuffles the deck
-    void Draw();                     // Just for testing
-    valRank DrawCard();              // Draws a card from the deck
-    void SaveDeck();
-    void LoadDeck();
+    Deck(CardMask composition = FullDeckMask); // e.g. ShortDeckHoldem::Deck, seeded from std::random_device
+    Deck(CardMask composition, Xoshiro256 rng); // Reproducible: same generator state, same cards
+    void SetRng(Xoshiro256 generator);          // Takes effect from the next card
+    void Reset();                      // Every card back in, dead ones too; O(1)
+    bool RemoveCard(CardIndex card);   // Marks an undealt card dead until the next Reset; false if it isn't undealt
+    int Remaining() const;             // Cards that can still be dealt
+    void Draw();                       // Just for testing
+    CardIndex DrawCard();              // Draws a card from the deck, resetting it first if it ran out
+    DeckSnapshot Snapshot() const;
+    bool Restore(const DeckSnapshot &snapshot); // False (deck unchanged) if the snapshot isn't a valid deck
+    bool SaveDeck(const string &path = "saves/deck.bin") const;
+    bool LoadDeck(const string &path = "saves/deck.bin");
 };
@@ -0,0 +1,298 @@
+#include "equity.hpp"
+#include "hand_eval.hpp"
+#include "rng.hpp"
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+using namespace std;
+
+static constexpr uint64_t SamplesPerChunk = 1024;
+
+static void addKnownCard(CardMask &known, CardIndex card)
+{
+    if (!isValidCard(card))
+        throw invalid_argument("equity: invalid card " + to_string(int(card)));
+    if (hasCard(known, card))
+        throw invalid_argument("equity: card " + to_string(int(card)) + " appears twice");
+    known |= cardBit(card);
+}
+
+// Win/tie counters for one worker, merged into the final result at the end
+struct EquityTally
+{
+    vector<uint64_t> wins, ties;
+    vector<uint64_t> splits; // [p * (players + 1) + k]: pots player p split k ways. Counts, not
+                             // fractions, so the result doesn't depend on the order tallies merge in.
+    uint64_t samples = 0;
+
+    explicit EquityTally(size_t players) : wins(players, 0), ties(players, 0), splits(players * (players + 1), 0) {}
+
+    void add(const vector<HandRank> &ranks)
+    {
+        HandRank best = *max_element(ranks.begin(), ranks.end());
+        int winners = int(count(ranks.begin(), ranks.end(), best));
+        for (size_t p = 0; p < ranks.size(); p++)
+        {
+            if (ranks[p] != best)
+                continue;
+            if (winners == 1)
+            {
+                wins[p]++;
+            }
+            else
+            {
+                ties[p]++;
+                splits[p * (ranks.size() + 1) + winners]++;
+            }
+        }
+        samples++;
+    }
+
+    void merge(const EquityTally &other)
+    {
+        for (size_t p = 0; p < wins.size(); p++)
+        {
+            wins[p] += other.wins[p];
+            ties[p] += other.ties[p];
+        }
+        for (size_t i = 0; i < splits.size(); i++)
+            splits[i] += other.splits[i];
+        samples += other.samples;
+    }
+
+    EquityResult result() const
+    {
+        EquityResult result;
+        result.samples = samples;
+        result.win.resize(wins.size());
+        result.tie.resize(wins.size());
+        result.equity.resize(wins.size());
+        for (size_t p = 0; p < wins.size() && samples; p++)
+        {
+            result.win[p] = double(wins[p]) / samples;
+            result.tie[p] = double(ties[p]) / samples;
+            double share = double(wins[p]);
+            for (size_t k = 2; k <= wins.size(); k++)
+                share += double(splits[p * (wins.size() + 1) + k]) / k;
+            result.equity[p] = share / samples;
+        }
+        return result;
+    }
+};
+
+static vector<CardIndex> liveCards(CardMask known)
+{
+    vector<CardIndex> live;
+    for (CardMask rest = FullDeckMask & ~known; rest; rest = popLowestCard(rest))
+        live.push_back(lowestCard(rest));
+    return live;
+}
+
+EquityResult calculateEquity(ThreadPool &pool, const EquityRequest &request)
+{
+    const size_t players = request.players.size();
+    if (players < 2)
+        throw invalid_argument("equity: need at least two players");
+    if (request.board.size() > 5)
+        throw invalid_argument("equity: board has more than five cards");
+
+    CardMask known = request.dead & FullDeckMask;
+    CardMask boardMask = 0;
+    for (CardIndex card : request.board)
+    {
+        addKnownCard(known, card);
+        boardMask |= cardBit(card);
+    }
+
+    vector<CardMask> holeMasks(players, 0);
+    int unknownHoleCards = 0;
+    for (size_t p = 0; p < players; p++)
+    {
+        for (CardIndex card : {request.players[p].first, request.players[p].second})
+        {
+            if (card == NoCard)
+            {
+                unknownHoleCards++;
+                continue;
+            }
+            addKnownCard(known, card);
+            holeMasks[p] |= cardBit(card);
+        }
+    }
+
+    vector<CardIndex> live = liveCards(known);
+
+    const int missingBoard = 5 - int(request.board.size());
+    const int needed = missingBoard + unknownHoleCards;
+    if (needed > int(live.size()))
+        throw invalid_argument("equity: not enough cards left in the deck");
+
+    const uint64_t seed = request.seed ? request.seed : randomSeed();
+
+    // Known cards are folded into each player's hand once, samples only add what they deal
+    vector<IncrementalHand> startHands(players);
+    for (size_t p = 0; p < players; p++)
+        startHands[p] = incrementalHandOf(boardMask | holeMasks[p]);
+
+    const auto deadline = chrono::steady_clock::now() + request.timeBudget;
+    const bool timed = request.timeBudget.count() > 0;
+    atomic<uint64_t> nextSample{0};
+
+    EquityTally total(players);
+    mutex resultMutex;
+
+    pool.runOnAll([&](unsigned)
+                  {
+        vector<CardIndex> deck;
+        vector<HandRank> ranks(players);
+        EquityTally tally(players);
+
+        while (true)
+        {
+            uint64_t start = nextSample.fetch_add(SamplesPerChunk);
+            if (start >= request.maxSamples || (timed && chrono::steady_clock::now() >= deadline))
+                break;
+            uint64_t end = min(start + SamplesPerChunk, request.maxSamples);
+
+            // Each chunk deals from its own stream and a fresh deck, so which worker takes it doesn't matter
+            Xoshiro256 rng = Xoshiro256::forStream(seed, start / SamplesPerChunk);
+            deck = live;
+
+            for (uint64_t s = start; s < end; s++)
+            {
+                // Partial Fisher-Yates: only the cards this sample needs
+                for (int k = 0; k < needed; k++)
+                    swap(deck[k], deck[k + rng.bounded(uint32_t(deck.size() - k))]);
+
+                int drawn = missingBoard;
+                for (size_t p = 0; p < players; p++)
+                {
+                    IncrementalHand h = startHands[p];
+                    for (int k = 0; k < missingBoard; k++)
+                        h.add(deck[k]);
+                    for (int k = cardCount(holeMasks[p]); k < 2; k++)
+                        h.add(deck[drawn++]);
+                    ranks[p] = h.rank();
+                }
+                tally.add(ranks);
+            }
+        }
+
+        lock_guard<mutex> lock(resultMutex);
+        total.merge(tally); });
+
+    return total.result();
+}
+
+// Deals every way of adding `left` more cards from live[from..] to the board, depth-first.
+// hands[depth] holds each player's hand so far, so a card is added once per subtree instead of
+// once per runout and the leaves only rank.
+static void enumerateRunouts(const vector<CardIndex> &live, size_t from, int left, vector<vector<IncrementalHand>> &hands, size_t depth,
+                             vector<HandRank> &ranks, EquityTally &tally)
+{
+    const auto &current = hands[depth];
+    if (left == 0)
+    {
+        for (size_t p = 0; p < current.size(); p++)
+            ranks[p] = current[p].rank();
+        tally.add(ranks);
+        return;
+    }
+
+    auto &next = hands[depth + 1];
+    for (size_t i = from; i + left <= live.size(); i++)
+    {
+        for (size_t p = 0; p < current.size(); p++)
+            next[p] = current[p].with(live[i]);
+        enumerateRunouts(live, i + 1, left - 1, hands, depth + 1, ranks, tally);
+    }
+}
+
+void enumerateEquityAsync(ThreadPool &pool, const vector<hand> &players, const vector<CardIndex> &board, CardMask dead,
+                          function<void(EquityResult)> done)
+{
+    if (players.size() < 2)
+        throw invalid_argument("equity: need at least two players");
+    if (board.size() > 5)
+        throw invalid_argument("equity: board has more than five cards");
+
+    struct Job
+    {
+        vector<IncrementalHand> startHands;
+        vector<CardIndex> live;
+        int missingBoard = 0;
+        atomic<size_t> nextFirstCard{0};
+        atomic<unsigned> tasksLeft{0};
+        mutex resultMutex;
+        EquityTally total;
+        function<void(EquityResult)> done;
+
+        explicit Job(size_t players) : total(players) {}
+    };
+
+    auto job = make_shared<Job>(players.size());
+    CardMask known = dead & FullDeckMask;
+    CardMask boardMask = 0;
+    for (CardIndex card : board)
+    {
+        addKnownCard(known, card);
+        boardMask |= cardBit(card);
+    }
+    for (const hand &h : players)
+    {
+        if (h.first == NoCard || h.second == NoCard)
+            throw invalid_argument("equity: exact enumeration needs every hole card");
+        addKnownCard(known, h.first);
+        addKnownCard(known, h.second);
+        job->startHands.push_back(incrementalHandOf(boardMask | cardBit(h.first) | cardBit(h.second)));
+    }
+    job->live = liveCards(known);
+    job->missingBoard = 5 - int(board.size());
+    job->done = std::move(done);
+
+    // Work is handed out one first runout card at a time, so uneven subtrees balance themselves
+    const unsigned tasks = job->missingBoard == 0 ? 1 : pool.size();
+    job->tasksLeft = tasks;
+    for (unsigned t = 0; t < tasks; t++)
+    {
+        pool.post([job]()
+                  {
+            const size_t players = job->startHands.size();
+            vector<HandRank> ranks(players);
+            EquityTally tally(players);
+            vector<vector<IncrementalHand>> hands(job->missingBoard + 1, job->startHands);
+
+            if (job->missingBoard == 0)
+            {
+                enumerateRunouts(job->live, 0, 0, hands, 0, ranks, tally);
+            }
+            else
+            {
+                size_t first;
+                while ((first = job->nextFirstCard.fetch_add(1)) + job->missingBoard <= job->live.size())
+                {
+                    for (size_t p = 0; p < players; p++)
+                        hands[1][p] = hands[0][p].with(job->live[first]);
+                    enumerateRunouts(job->live, first + 1, job->missingBoard - 1, hands, 1, ranks, tally);
+                }
+            }
+
+            {
+                lock_guard<mutex> lock(job->resultMutex);
+                job->total.merge(tally);
+            }
+            if (--job->tasksLeft == 0)
+                job->done(job->total.result()); });
+    }
+}
+
+EquityResult enumerateEquity(ThreadPool &pool, const vector<hand> &players, const vector<CardIndex> &board, CardMask dead)
+{
+    promise<EquityResult> result;
+    enumerateEquityAsync(pool, players, board, dead, [&](EquityResult r)
+                         { result.set_value(std::move(r)); });
+    return result.get_future().get();
+}
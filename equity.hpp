@@ -0,0 +1,46 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "card_mask.hpp"
+#include "thread_pool.hpp"
+
+// Monte Carlo hold'em equity on top of hand_eval.hpp.
+//
+// Samples are dealt in fixed-size chunks, each from its own Xoshiro256 stream (derived from the
+// request seed and the chunk's index), whichever worker of the pool picks it up. So a fixed seed
+// gives the same result whatever the thread count, as long as there's no time budget. Sampling
+// stops at maxSamples or when the time budget runs out, whichever comes first.
+
+struct EquityRequest
+{
+    std::vector<hand> players;        // NoCard for an unknown hole card
+    std::vector<CardIndex> board;     // 0 to 5 known community cards
+    CardMask dead = 0;                // Cards known to be out of play (mucked, burnt, ...)
+    std::uint64_t maxSamples = 100000;
+    std::chrono::milliseconds timeBudget{0}; // 0: no time limit
+    std::uint64_t seed = 0;                  // 0: seed from std::random_device
+};
+
+struct EquityResult
+{
+    std::vector<double> win;    // Probability of winning the pot alone
+    std::vector<double> tie;    // Probability of splitting it
+    std::vector<double> equity; // Expected share of the pot
+    std::uint64_t samples = 0;
+};
+
+// Throws std::invalid_argument for fewer than two players, more than five board cards or a card
+// that appears twice.
+EquityResult calculateEquity(ThreadPool &pool, const EquityRequest &request);
+
+// Exact equity over every possible runout of the board (up to C(48,5) boards heads-up preflop),
+// for when every hole card is known, e.g. once all players are all-in. Each runout's board mask
+// is built once and shared by all players.
+//
+// The async version splits the runouts into pool tasks and returns at once; done is called on a
+// pool thread after the last task finishes. The blocking version must not be called from a pool task.
+void enumerateEquityAsync(ThreadPool &pool, const std::vector<hand> &players, const std::vector<CardIndex> &board, CardMask dead,
+                          std::function<void(EquityResult)> done);
+EquityResult enumerateEquity(ThreadPool &pool, const std::vector<hand> &players, const std::vector<CardIndex> &board, CardMask dead = 0);
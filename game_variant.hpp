@@ -0,0 +1,108 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <vector>
+#include "hand_eval.hpp"
+
+// Game variants for the showdown code.
+//
+// A variant fixes how many hole cards are dealt, how many of them a hand has to use, which cards
+// are in the deck and how hands are ordered (a Ranking from hand_eval.hpp). evaluateHand and
+// determineWinners are instantiated per variant, so the rules are resolved at compile time and
+// each variant gets its own branch-free path instead of checking the game on every hand.
+
+struct Holdem
+{
+    static constexpr const char *Name = "Texas Hold'em";
+    static constexpr int HoleCards = 2;
+    static constexpr int HoleCardsUsed = 0; // 0: any number of them, best 5 of hole + board
+    static constexpr CardMask Deck = FullDeckMask;
+    using Ranking = StandardRanking;
+};
+
+struct ShortDeckHoldem
+{
+    static constexpr const char *Name = "Short Deck Hold'em";
+    static constexpr int HoleCards = 2;
+    static constexpr int HoleCardsUsed = 0;
+    static constexpr CardMask Deck = 0x1FF01FF01FF01FF0ull; // Sixes to aces
+    using Ranking = ShortDeckRanking;
+};
+
+struct Omaha
+{
+    static constexpr const char *Name = "Pot Limit Omaha";
+    static constexpr int HoleCards = 4;
+    static constexpr int HoleCardsUsed = 2; // Exactly two hole cards and three from the board
+    static constexpr CardMask Deck = FullDeckMask;
+    using Ranking = StandardRanking;
+};
+
+// Best hand a player makes from their hole cards and a full (5 card) board. The result is the
+// usual HandRank, compare through Variant::Ranking::strength.
+template <typename Variant>
+constexpr HandRank evaluateHand(CardMask hole, CardMask board)
+{
+    using Ranking = typename Variant::Ranking;
+
+    if constexpr (Variant::HoleCardsUsed == 0)
+    {
+        return evaluateMask<Ranking>(hole | board);
+    }
+    else
+    {
+        static_assert(Variant::HoleCardsUsed == 2, "only two-card hole combinations are supported");
+
+        // Every 3-card part of the board is built once, each pair of hole cards goes on top of it
+        std::array<IncrementalHand, 10> boardParts{};
+        int parts = 0;
+        for (CardMask a = board; a; a = popLowestCard(a))
+            for (CardMask b = popLowestCard(a); b; b = popLowestCard(b))
+                for (CardMask c = popLowestCard(b); c; c = popLowestCard(c))
+                    boardParts[parts++] = IncrementalHand{}.with(lowestCard(a)).with(lowestCard(b)).with(lowestCard(c));
+
+        HandRank best = 0;
+        for (CardMask a = hole; a; a = popLowestCard(a))
+        {
+            for (CardMask b = popLowestCard(a); b; b = popLowestCard(b))
+            {
+                for (int p = 0; p < parts; p++)
+                {
+                    HandRank rank = boardParts[p].with(lowestCard(a)).with(lowestCard(b)).template rank<Ranking>();
+                    if (Ranking::strength(rank) > Ranking::strength(best))
+                        best = rank;
+                }
+            }
+        }
+        return best;
+    }
+}
+
+// Indices of the players whose hands are the strongest at showdown (several on a split pot)
+template <typename Variant>
+std::vector<int> determineWinners(const std::vector<CardMask> &holes, CardMask board)
+{
+    std::vector<HandRank> strengths(holes.size());
+    for (size_t i = 0; i < holes.size(); i++)
+        strengths[i] = Variant::Ranking::strength(evaluateHand<Variant>(holes[i], board));
+
+    std::vector<int> winners;
+    if (strengths.empty())
+        return winners;
+    HandRank best = *std::max_element(strengths.begin(), strengths.end());
+    for (size_t i = 0; i < strengths.size(); i++)
+    {
+        if (strengths[i] == best)
+            winners.push_back(int(i));
+    }
+    return winners;
+}
+
+// Short deck: A-6-7-8-9 is a straight and a flush outranks a full house
+static_assert(evaluateHand<ShortDeckHoldem>(maskOf(std::array{makeCard(14, 0), makeCard(6, 1)}),
+                                            maskOf(std::array{makeCard(7, 2), makeCard(8, 3), makeCard(9, 0), makeCard(13, 1), makeCard(13, 2)})) == 0x590000);
+static_assert(ShortDeckRanking::strength(makeRank(Flush, 0x98764)) > ShortDeckRanking::strength(makeRank(FullHouse, 0xED000)));
+static_assert(StandardRanking::strength(makeRank(Flush, 0x98764)) < StandardRanking::strength(makeRank(FullHouse, 0xED000)));
+// Omaha: four hearts on the board and one in hand is no flush; best is A-K-Q from the board with T-5
+static_assert(evaluateHand<Omaha>(maskOf(std::array{makeCard(10, 0), makeCard(3, 1), makeCard(4, 2), makeCard(5, 3)}),
+                                  maskOf(std::array{makeCard(14, 0), makeCard(13, 0), makeCard(12, 0), makeCard(11, 0), makeCard(2, 3)})) == 0x1EDCA5);
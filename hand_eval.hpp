@@ -0,0 +1,306 @@
+#pragma once
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include "card_mask.hpp"
+
+// Table-driven hand evaluator.
+//
+// A hand is a CardMask (card_mask.hpp) with one 16-bit lane per suit, so every suit is a 13-bit
+// rank mask and the rank counts of the whole hand fall out of a few ANDs/ORs across the lanes.
+// Everything else is a load from two 8192-entry tables indexed by a rank mask.
+//
+// The result is a HandRank: the Score tuple from visual.hpp packed into nibbles
+// (category << 20 | five values), so comparing two HandRanks orders hands exactly like
+// comparing their Scores. Valid for 5 to 7 cards.
+
+using HandRank = std::uint32_t;
+
+enum HandCategory : HandRank
+{
+    HighCard = 1,
+    OnePair,
+    TwoPair,
+    ThreeOfAKind,
+    Straight,
+    Flush,
+    FullHouse,
+    FourOfAKind,
+    StraightFlush,
+    RoyalFlush
+};
+
+constexpr HandRank makeRank(HandCategory category, HandRank values)
+{
+    return HandRank(category) << 20 | values;
+}
+
+constexpr HandCategory categoryOf(HandRank rank)
+{
+    return HandCategory(rank >> 20);
+}
+
+constexpr const char *categoryName(HandCategory category)
+{
+    constexpr const char *names[] = {"", "High Card", "One Pair", "Two Pair", "Three of a Kind", "Straight",
+                                     "Flush", "Full House", "Four of a Kind", "Straight Flush", "Royal Flush"};
+    return category <= RoyalFlush ? names[category] : "";
+}
+
+// Built at compile time: the tables live in read-only data and cost nothing at startup
+struct RankTables
+{
+    std::array<std::uint8_t, 8192> straightHigh{}; // Value of the best straight in a rank mask, 0 if none
+    std::array<std::uint32_t, 8192> topFive{};     // Five highest values in a rank mask, one nibble each
+
+    constexpr RankTables()
+    {
+        for (unsigned mask = 0; mask < 8192; mask++)
+        {
+            for (int high = 14; high >= 6; high--)
+            {
+                unsigned run = 0x1Fu << (high - 6);
+                if ((mask & run) == run)
+                {
+                    straightHigh[mask] = std::uint8_t(high);
+                    break;
+                }
+            }
+            if (straightHigh[mask] == 0 && (mask & 0x100F) == 0x100F)
+                straightHigh[mask] = 5; // A-2-3-4-5
+
+            std::uint32_t packed = 0;
+            int taken = 0;
+            for (int bit = 12; bit >= 0 && taken < 5; bit--)
+            {
+                if (mask & (1u << bit))
+                {
+                    packed |= std::uint32_t(bit + 2) << (16 - 4 * taken);
+                    taken++;
+                }
+            }
+            topFive[mask] = packed;
+        }
+    }
+};
+
+inline constexpr RankTables RankTablesData{};
+
+constexpr const RankTables &rankTables()
+{
+    return RankTablesData;
+}
+
+constexpr HandRank topValue(unsigned mask)
+{
+    return HandRank(std::bit_width(mask) + 1);
+}
+
+// Hand ordering rules, picked per game variant (game_variant.hpp). straightHigh gives the value of
+// the best straight in a rank mask and strength maps a HandRank to the key hands are compared by.
+struct StandardRanking
+{
+    static constexpr HandRank straightHigh(unsigned ranks)
+    {
+        return rankTables().straightHigh[ranks];
+    }
+
+    static constexpr HandRank strength(HandRank rank)
+    {
+        return rank;
+    }
+};
+
+// Short deck (6+): with no deuces to fives A-6-7-8-9 is the lowest straight, and a flush beats a
+// full house. The two can't both be made from 7 cards, so only the comparison changes.
+struct ShortDeckRanking
+{
+    static constexpr HandRank straightHigh(unsigned ranks)
+    {
+        if (HandRank high = rankTables().straightHigh[ranks])
+            return high;
+        return (ranks & 0x10F0) == 0x10F0 ? 9 : 0;
+    }
+
+    static constexpr HandRank strength(HandRank rank)
+    {
+        HandCategory category = categoryOf(rank);
+        if (category == Flush || category == FullHouse)
+            return makeRank(HandCategory(Flush + FullHouse - category), rank & 0xFFFFF);
+        return rank;
+    }
+};
+
+template <typename Ranking = StandardRanking>
+constexpr HandRank flushRank(unsigned suitRanks)
+{
+    const RankTables &t = rankTables();
+    HandRank high = Ranking::straightHigh(suitRanks);
+    if (high == 14)
+        return makeRank(RoyalFlush, high << 16);
+    if (high)
+        return makeRank(StraightFlush, high << 16);
+    return makeRank(Flush, t.topFive[suitRanks]);
+}
+
+// Best non-flush hand from the rank masks of values held at least once, twice, three and four times
+template <typename Ranking = StandardRanking>
+constexpr HandRank rankFromCounts(unsigned any, unsigned twoPlus, unsigned threePlus, unsigned four)
+{
+    const RankTables &t = rankTables();
+
+    if (four)
+    {
+        HandRank quad = topValue(four);
+        unsigned rest = any & ~(1u << (quad - 2));
+        return makeRank(FourOfAKind, quad << 16 | (t.topFive[rest] >> 16) << 12);
+    }
+
+    if (threePlus)
+    {
+        HandRank trips = topValue(threePlus);
+        unsigned tripsBit = 1u << (trips - 2);
+        unsigned pairs = twoPlus & ~tripsBit;
+        if (pairs)
+            return makeRank(FullHouse, trips << 16 | topValue(pairs) << 12);
+    }
+
+    if (HandRank high = Ranking::straightHigh(any))
+        return makeRank(Straight, high << 16);
+
+    if (threePlus)
+    {
+        HandRank trips = topValue(threePlus);
+        unsigned rest = any & ~(1u << (trips - 2));
+        return makeRank(ThreeOfAKind, trips << 16 | (t.topFive[rest] >> 12) << 8);
+    }
+
+    if (twoPlus)
+    {
+        HandRank highPair = topValue(twoPlus);
+        unsigned lowPairs = twoPlus & ~(1u << (highPair - 2));
+        if (lowPairs)
+        {
+            HandRank lowPair = topValue(lowPairs);
+            unsigned rest = any & ~(1u << (highPair - 2)) & ~(1u << (lowPair - 2));
+            return makeRank(TwoPair, highPair << 16 | lowPair << 12 | (t.topFive[rest] >> 16) << 8);
+        }
+        unsigned rest = any & ~(1u << (highPair - 2));
+        return makeRank(OnePair, highPair << 16 | (t.topFive[rest] >> 8) << 4);
+    }
+
+    return makeRank(HighCard, t.topFive[any]);
+}
+
+template <typename Ranking = StandardRanking>
+constexpr HandRank evaluateMask(CardMask cards)
+{
+    const unsigned s0 = suitRanks(cards, 0);
+    const unsigned s1 = suitRanks(cards, 1);
+    const unsigned s2 = suitRanks(cards, 2);
+    const unsigned s3 = suitRanks(cards, 3);
+
+    // With at most 7 cards a flush rules out quads and full houses, so it can return straight away
+    for (unsigned suit : {s0, s1, s2, s3})
+    {
+        if (std::popcount(suit) >= 5)
+            return flushRank<Ranking>(suit);
+    }
+
+    return rankFromCounts<Ranking>(s0 | s1 | s2 | s3,
+                          (s0 & s1) | (s2 & s3) | ((s0 | s1) & (s2 | s3)),
+                          (s0 & s1 & (s2 | s3)) | (s2 & s3 & (s0 | s1)),
+                          s0 & s1 & s2 & s3);
+}
+
+// A hand built up one card at a time (hole cards, then each street). Adding a card only bumps
+// the rank-count masks and the suit counters, so ranking a 7-card hand that shares its first
+// cards with others (every runout of a board, every player on a street) skips redoing the shared part.
+struct IncrementalHand
+{
+    CardMask cards = 0;
+    unsigned any = 0, twoPlus = 0, threePlus = 0, four = 0; // Values held at least once ... four times
+    std::uint32_t suitCounts = 0;                           // One byte per suit
+
+    constexpr void add(CardIndex card)
+    {
+        unsigned bit = 1u << (card & 0xF);
+        four |= threePlus & bit;
+        threePlus |= twoPlus & bit;
+        twoPlus |= any & bit;
+        any |= bit;
+        suitCounts += 1u << (8 * cardSuit(card));
+        cards |= cardBit(card);
+    }
+
+    constexpr IncrementalHand with(CardIndex card) const
+    {
+        IncrementalHand next = *this;
+        next.add(card);
+        return next;
+    }
+
+    constexpr int size() const
+    {
+        return cardCount(cards);
+    }
+
+    // Same result as evaluateMask(cards); needs 5 to 7 cards
+    template <typename Ranking = StandardRanking>
+    constexpr HandRank rank() const
+    {
+        // A suit byte reaches 0x80 after adding 123 exactly when it holds five or more cards
+        std::uint32_t flushSuits = (suitCounts + 0x7B7B7B7Bu) & 0x80808080u;
+        if (flushSuits)
+            return flushRank<Ranking>(suitRanks(cards, std::countr_zero(flushSuits) / 8));
+        return rankFromCounts<Ranking>(any, twoPlus, threePlus, four);
+    }
+};
+
+constexpr IncrementalHand incrementalHandOf(CardMask cards)
+{
+    IncrementalHand hand;
+    for (; cards; cards = popLowestCard(cards))
+        hand.add(lowestCard(cards));
+    return hand;
+}
+
+constexpr HandRank evaluateCards(std::initializer_list<CardIndex> cards)
+{
+    return evaluateMask(maskOf(cards));
+}
+
+// Compile-time checks of the tables and of every category against the Scores the reference
+// score5/bestof7 in visual.hpp give for the same hands. tools/hand_distribution runs the full
+// check over every 7-card hand.
+static_assert(rankTables().straightHigh[0x100F] == 5);
+static_assert(rankTables().straightHigh[0x1F00] == 14);
+static_assert(rankTables().topFive[0x1FFF] == 0xEDCBA);
+static_assert(incrementalHandOf(0x1F00ull << 16).with(makeCard(2, 0)).with(makeCard(2, 2)).rank() == 0xAE0000);
+
+// Royal flush over a second ace: Score{10, 14}
+static_assert(evaluateCards({makeCard(14, 1), makeCard(13, 1), makeCard(12, 1), makeCard(11, 1), makeCard(10, 1), makeCard(14, 2), makeCard(2, 3)}) == 0xAE0000);
+// Six-card flush holding a wheel straight flush: Score{9, 5}
+static_assert(evaluateCards({makeCard(14, 0), makeCard(2, 0), makeCard(3, 0), makeCard(4, 0), makeCard(5, 0), makeCard(9, 0), makeCard(6, 1)}) == 0x950000);
+// Quads with trips beside them: Score{8, 5, 13}
+static_assert(evaluateCards({makeCard(5, 0), makeCard(5, 1), makeCard(5, 2), makeCard(5, 3), makeCard(13, 0), makeCard(13, 1), makeCard(13, 2)}) == 0x85D000);
+// Two sets: Score{7, 9, 4}
+static_assert(evaluateCards({makeCard(9, 0), makeCard(9, 1), makeCard(9, 2), makeCard(4, 0), makeCard(4, 1), makeCard(4, 2), makeCard(14, 3)}) == 0x794000);
+// Flush beats the straight on the same board: Score{6, 13, 10, 8, 7, 6}
+static_assert(evaluateCards({makeCard(13, 2), makeCard(10, 2), makeCard(8, 2), makeCard(7, 2), makeCard(6, 2), makeCard(9, 1), makeCard(5, 0)}) == 0x6DA876);
+// Wheel: Score{5, 5}
+static_assert(evaluateCards({makeCard(14, 0), makeCard(2, 1), makeCard(3, 2), makeCard(4, 3), makeCard(5, 0), makeCard(9, 1), makeCard(13, 2)}) == 0x550000);
+// Trips: Score{4, 7, 14, 12}
+static_assert(evaluateCards({makeCard(7, 0), makeCard(7, 1), makeCard(7, 2), makeCard(14, 3), makeCard(12, 0), makeCard(3, 1), makeCard(2, 2)}) == 0x47EC00);
+// Three pairs, kicker from the lowest pair: Score{3, 12, 9, 6}
+static_assert(evaluateCards({makeCard(12, 0), makeCard(12, 1), makeCard(9, 2), makeCard(9, 3), makeCard(6, 0), makeCard(6, 1), makeCard(3, 2)}) == 0x3C9600);
+// One pair: Score{2, 11, 14, 8, 6}
+static_assert(evaluateCards({makeCard(11, 0), makeCard(11, 1), makeCard(14, 2), makeCard(8, 3), makeCard(6, 0), makeCard(3, 1), makeCard(2, 2)}) == 0x2BE860);
+// High card: Score{1, 13, 11, 9, 7, 5}
+static_assert(evaluateCards({makeCard(13, 0), makeCard(11, 1), makeCard(9, 2), makeCard(7, 3), makeCard(5, 0), makeCard(3, 1), makeCard(2, 2)}) == 0x1DB975);
+
+// Ranks count hands into ranks[0..count), eight at a time with AVX2 when the CPU has it and one
+// at a time through evaluateMask otherwise. Results are identical either way.
+void evaluateBatch(const CardMask *hands, HandRank *ranks, std::size_t count);
@@ -0,0 +1,178 @@
+#include "hand_eval.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define POKER_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define POKER_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define POKER_TARGET_AVX2
+#endif
+
+static void evaluateBatchScalar(const CardMask *hands, HandRank *ranks, std::size_t count)
+{
+    for (std::size_t i = 0; i < count; i++)
+        ranks[i] = evaluateMask(hands[i]);
+}
+
+#ifdef POKER_X86
+
+static bool cpuHasAvx2()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+// Value of the highest set bit in each lane (0 for an empty mask), read off the float exponent
+POKER_TARGET_AVX2 static inline __m256i topValue8(__m256i mask)
+{
+    __m256i exponent = _mm256_srli_epi32(_mm256_castps_si256(_mm256_cvtepi32_ps(mask)), 23);
+    return _mm256_max_epi32(_mm256_sub_epi32(exponent, _mm256_set1_epi32(125)), _mm256_setzero_si256());
+}
+
+// Rank-mask bit of a value; a zero value shifts out to an empty mask
+POKER_TARGET_AVX2 static inline __m256i valueBit8(__m256i value)
+{
+    return _mm256_sllv_epi32(_mm256_set1_epi32(1), _mm256_sub_epi32(value, _mm256_set1_epi32(2)));
+}
+
+POKER_TARGET_AVX2 static inline __m256i popcount8(__m256i v)
+{
+    v = _mm256_sub_epi32(v, _mm256_and_si256(_mm256_srli_epi32(v, 1), _mm256_set1_epi32(0x55555555)));
+    v = _mm256_add_epi32(_mm256_and_si256(v, _mm256_set1_epi32(0x33333333)),
+                         _mm256_and_si256(_mm256_srli_epi32(v, 2), _mm256_set1_epi32(0x33333333)));
+    v = _mm256_and_si256(_mm256_add_epi32(v, _mm256_srli_epi32(v, 4)), _mm256_set1_epi32(0x0F0F0F0F));
+    return _mm256_srli_epi32(_mm256_mullo_epi32(v, _mm256_set1_epi32(0x01010101)), 24);
+}
+
+POKER_TARGET_AVX2 static inline __m256i gatherTopFive(const RankTables &t, __m256i mask)
+{
+    return _mm256_i32gather_epi32(reinterpret_cast<const int *>(t.topFive.data()), mask, 4);
+}
+
+// straightHigh is a byte table, so gather the containing word and shift the byte down
+POKER_TARGET_AVX2 static inline __m256i gatherStraightHigh(const RankTables &t, __m256i mask)
+{
+    __m256i words = _mm256_i32gather_epi32(reinterpret_cast<const int *>(t.straightHigh.data()), _mm256_srli_epi32(mask, 2), 4);
+    __m256i shift = _mm256_slli_epi32(_mm256_and_si256(mask, _mm256_set1_epi32(3)), 3);
+    return _mm256_and_si256(_mm256_srlv_epi32(words, shift), _mm256_set1_epi32(0xFF));
+}
+
+POKER_TARGET_AVX2 static inline __m256i rankOf8(HandCategory category, __m256i values)
+{
+    return _mm256_or_si256(_mm256_set1_epi32(int(HandRank(category) << 20)), values);
+}
+
+// Same result as evaluateMask, eight hands at a time. Every category is scored branch-free and
+// masked to zero when the hand doesn't make it; since categories dominate, the answer is the max.
+POKER_TARGET_AVX2 static void evaluateBatchAvx2(const CardMask *hands, HandRank *ranks, std::size_t count)
+{
+    const RankTables &t = rankTables();
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i laneMask = _mm256_set1_epi32(0x1FFF);
+
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 a = _mm256_castsi256_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(hands + i)));
+        __m256 b = _mm256_castsi256_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(hands + i + 4)));
+        __m256i lo = _mm256_permute4x64_epi64(_mm256_castps_si256(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0))), _MM_SHUFFLE(3, 1, 2, 0));
+        __m256i hi = _mm256_permute4x64_epi64(_mm256_castps_si256(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))), _MM_SHUFFLE(3, 1, 2, 0));
+
+        __m256i s0 = _mm256_and_si256(lo, laneMask);
+        __m256i s1 = _mm256_srli_epi32(lo, 16);
+        __m256i s2 = _mm256_and_si256(hi, laneMask);
+        __m256i s3 = _mm256_srli_epi32(hi, 16);
+
+        // Flushes: at most one suit can hold five cards
+        const __m256i four = _mm256_set1_epi32(4);
+        __m256i flushSuit = _mm256_and_si256(s0, _mm256_cmpgt_epi32(popcount8(s0), four));
+        flushSuit = _mm256_or_si256(flushSuit, _mm256_and_si256(s1, _mm256_cmpgt_epi32(popcount8(s1), four)));
+        flushSuit = _mm256_or_si256(flushSuit, _mm256_and_si256(s2, _mm256_cmpgt_epi32(popcount8(s2), four)));
+        flushSuit = _mm256_or_si256(flushSuit, _mm256_and_si256(s3, _mm256_cmpgt_epi32(popcount8(s3), four)));
+
+        __m256i flushHigh = gatherStraightHigh(t, flushSuit);
+        __m256i straightFlushCategory = _mm256_sub_epi32(_mm256_set1_epi32(StraightFlush), _mm256_cmpeq_epi32(flushHigh, _mm256_set1_epi32(14)));
+        __m256i straightFlushRank = _mm256_or_si256(_mm256_slli_epi32(straightFlushCategory, 20), _mm256_slli_epi32(flushHigh, 16));
+        __m256i flushRank = _mm256_blendv_epi8(rankOf8(Flush, gatherTopFive(t, flushSuit)), straightFlushRank, _mm256_cmpgt_epi32(flushHigh, zero));
+        __m256i best = _mm256_and_si256(flushRank, _mm256_cmpgt_epi32(flushSuit, zero));
+
+        __m256i any = _mm256_or_si256(_mm256_or_si256(s0, s1), _mm256_or_si256(s2, s3));
+        __m256i s01 = _mm256_and_si256(s0, s1);
+        __m256i s23 = _mm256_and_si256(s2, s3);
+        __m256i twoPlus = _mm256_or_si256(_mm256_or_si256(s01, s23), _mm256_and_si256(_mm256_or_si256(s0, s1), _mm256_or_si256(s2, s3)));
+        __m256i threePlus = _mm256_or_si256(_mm256_and_si256(s01, _mm256_or_si256(s2, s3)), _mm256_and_si256(s23, _mm256_or_si256(s0, s1)));
+        __m256i quads = _mm256_and_si256(s01, s23);
+
+        __m256i quad = topValue8(quads);
+        __m256i quadKicker = topValue8(_mm256_andnot_si256(valueBit8(quad), any));
+        __m256i quadRank = rankOf8(FourOfAKind, _mm256_or_si256(_mm256_slli_epi32(quad, 16), _mm256_slli_epi32(quadKicker, 12)));
+        best = _mm256_max_epu32(best, _mm256_and_si256(quadRank, _mm256_cmpgt_epi32(quads, zero)));
+
+        __m256i trips = topValue8(threePlus);
+        __m256i tripsBit = valueBit8(trips);
+        __m256i fullHousePair = topValue8(_mm256_andnot_si256(tripsBit, twoPlus));
+        __m256i fullHouseRank = rankOf8(FullHouse, _mm256_or_si256(_mm256_slli_epi32(trips, 16), _mm256_slli_epi32(fullHousePair, 12)));
+        __m256i hasTrips = _mm256_cmpgt_epi32(threePlus, zero);
+        best = _mm256_max_epu32(best, _mm256_and_si256(fullHouseRank, _mm256_and_si256(hasTrips, _mm256_cmpgt_epi32(fullHousePair, zero))));
+
+        __m256i straightHigh = gatherStraightHigh(t, any);
+        __m256i straightRank = rankOf8(Straight, _mm256_slli_epi32(straightHigh, 16));
+        best = _mm256_max_epu32(best, _mm256_and_si256(straightRank, _mm256_cmpgt_epi32(straightHigh, zero)));
+
+        __m256i tripsKickers = _mm256_srli_epi32(gatherTopFive(t, _mm256_andnot_si256(tripsBit, any)), 12);
+        __m256i tripsRank = rankOf8(ThreeOfAKind, _mm256_or_si256(_mm256_slli_epi32(trips, 16), _mm256_slli_epi32(tripsKickers, 8)));
+        best = _mm256_max_epu32(best, _mm256_and_si256(tripsRank, hasTrips));
+
+        __m256i highPair = topValue8(twoPlus);
+        __m256i highPairBit = valueBit8(highPair);
+        __m256i lowPairs = _mm256_andnot_si256(highPairBit, twoPlus);
+        __m256i lowPair = topValue8(lowPairs);
+        __m256i twoPairKicker = topValue8(_mm256_andnot_si256(_mm256_or_si256(highPairBit, valueBit8(lowPair)), any));
+        __m256i twoPairRank = rankOf8(TwoPair, _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(highPair, 16), _mm256_slli_epi32(lowPair, 12)), _mm256_slli_epi32(twoPairKicker, 8)));
+        best = _mm256_max_epu32(best, _mm256_and_si256(twoPairRank, _mm256_cmpgt_epi32(lowPairs, zero)));
+
+        __m256i pairKickers = _mm256_srli_epi32(gatherTopFive(t, _mm256_andnot_si256(highPairBit, any)), 8);
+        __m256i pairRank = rankOf8(OnePair, _mm256_or_si256(_mm256_slli_epi32(highPair, 16), _mm256_slli_epi32(pairKickers, 4)));
+        best = _mm256_max_epu32(best, _mm256_and_si256(pairRank, _mm256_cmpgt_epi32(twoPlus, zero)));
+
+        best = _mm256_max_epu32(best, rankOf8(HighCard, gatherTopFive(t, any)));
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(ranks + i), best);
+    }
+
+    evaluateBatchScalar(hands + i, ranks + i, count - i);
+}
+
+#endif
+
+void evaluateBatch(const CardMask *hands, HandRank *ranks, std::size_t count)
+{
+#ifdef POKER_X86
+    static const bool avx2 = cpuHasAvx2();
+    if (avx2)
+    {
+        evaluateBatchAvx2(hands, ranks, count);
+        return;
+    }
+#endif
+    evaluateBatchScalar(hands, ranks, count);
+}
@@ -18,6 +18,15 @@
 #include <mutex>
 #include <atomic>
 #include <sstream>
+#include <array>
+#include <charconv>
+#include <limits>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <variant>
+#include "card_mask.hpp"
+#include "snapshot.hpp"
 using boost::asio::ip::tcp;
 
 struct valRank
@@ -25,7 +34,10 @@ struct valRank
     int value;
     int suit;
 };
-using hand = std::pair<valRank, valRank>;
+inline valRank toValRank(CardIndex card)
+{
+    return valRank{cardValue(card), cardSuit(card)};
+}
 
 enum class MessageTypeClientToServer
 {
@@ -35,7 +47,8 @@ enum class MessageTypeClientToServer
     Action,
     RequestState,
     Leave,
-    AdminPlay
+    AdminPlay,
+    RequestRoster
 };
 
 enum class MessageTypeServerToClient
@@ -51,7 +64,9 @@ enum class MessageTypeServerToClient
     CommunityCard,
     PlayerHand,
     PotUpdate,
-    Showdown
+    Showdown,
+    AllInEquity,
+    Roster
 };
 
 enum class PlayerActionType
@@ -73,362 +88,708 @@ enum class GameState
     Showdown
 };
 
-struct MessageClientToServer
+// Room for a list inside a message, so every message stays trivially copyable
+template <typename T, std::size_t N>
+struct FixedList
 {
-    MessageTypeClientToServer type;
+    static constexpr std::size_t Capacity = N;
 
-    std::string name;     // For JOIN
-    std::string chatText; // For CHAT
+    std::uint8_t count = 0;
+    T items[N];
 
-    PlayerActionType action; // For ACTION
-    int actionAmount = 0;    // For BET/RAISE
+    constexpr bool push_back(const T &item) // False, and nothing added, if the list is full
+    {
+        if (count == N)
+            return false;
+        items[count++] = item;
+        return true;
+    }
+    constexpr void clear() { count = 0; }
+    constexpr std::size_t size() const { return count; }
+    constexpr bool empty() const { return count == 0; }
+    constexpr const T *begin() const { return items; }
+    constexpr const T *end() const { return items + count; }
 };
 
-struct MessageServerToClient
+struct WinnerShare
 {
-    MessageTypeServerToClient type;
+    int playerId;
+    int amount; // Over all pots
+    static constexpr auto fields() { return std::make_tuple(&WinnerShare::playerId, &WinnerShare::amount); }
+};
 
-    int playerId = -1;
-    int playerSum = 0;
-    int potAmount = 0;
+struct PlayerEquity
+{
+    int playerId;
+    int equity; // Tenths of a percent
+    static constexpr auto fields() { return std::make_tuple(&PlayerEquity::playerId, &PlayerEquity::equity); }
+};
 
-    std::string name;
+struct RosterEntry
+{
+    int playerId;
+    int money;
+    std::string_view name; // One word, see Client::handle_message
+    static constexpr auto fields() { return std::make_tuple(&RosterEntry::playerId, &RosterEntry::money, &RosterEntry::name); }
+};
 
-    std::unordered_map<int, std::string> playerNames = {};
-    std::unordered_map<int, int> playerMoney = {};
-    std::string chatText = "";
+constexpr std::size_t RosterChunk = 8; // Players per Roster message; a bigger lobby takes several
+
+// The message schema. Every message is one small trivially copyable struct carrying its Type tag,
+// its text Command and fields(), the members that go on the wire in order. That declaration is
+// all there is: the text codec below, the binary codec in binary_protocol.hpp, the command lookup
+// and the compile-time round-trip checks are all generated from it. A new message is a struct, an
+// enum value and a slot in its direction's variant.
+//
+// Strings are views: into the sender's state while encoding, into the receive buffer while a
+// decoded message is handled. Copy what has to outlive that.
+namespace ToServer
+{
+struct Join
+{
+    static constexpr auto Type = MessageTypeClientToServer::Join;
+    static constexpr std::string_view Command = "JOIN";
+    std::string_view name;
+    static constexpr auto fields() { return std::make_tuple(&Join::name); }
+};
 
-    GameState gameState = GameState::WaitingForPlayers;
+struct Ready
+{
+    static constexpr auto Type = MessageTypeClientToServer::Ready;
+    static constexpr std::string_view Command = "READY";
+    static constexpr auto fields() { return std::make_tuple(); }
+};
 
-    PlayerActionType action = PlayerActionType::Failed;
-    int actionAmount = 0;
+struct Chat
+{
+    static constexpr auto Type = MessageTypeClientToServer::Chat;
+    static constexpr std::string_view Command = "CHAT";
+    std::string_view text;
+    static constexpr auto fields() { return std::make_tuple(&Chat::text); }
+};
 
-    std::string cards; // later can be vector<Card>
+struct Action
+{
+    static constexpr auto Type = MessageTypeClientToServer::Action;
+    static constexpr std::string_view Command = "ACTION";
+    PlayerActionType action = PlayerActionType::Fold;
+    int amount = 0; // For BET/RAISE
+    static constexpr auto fields() { return std::make_tuple(&Action::action, &Action::amount); }
+};
 
-    std::vector<int> idWinners = {}; // For Showdown
+struct RequestState
+{
+    static constexpr auto Type = MessageTypeClientToServer::RequestState;
+    static constexpr std::string_view Command = "REQUEST_STATE";
+    static constexpr auto fields() { return std::make_tuple(); }
+};
 
-    int toAct = -1;     // For GameState
-    int toCall = 0;     // For GameState
-    int currentBet = 0; // For GameState
-    int minRaise = 0;   // For GameState
+struct Leave
+{
+    static constexpr auto Type = MessageTypeClientToServer::Leave;
+    static constexpr std::string_view Command = "LEAVE";
+    static constexpr auto fields() { return std::make_tuple(); }
 };
 
-inline std::string serialize_client(const MessageClientToServer &m)
+struct AdminPlay
+{
+    static constexpr auto Type = MessageTypeClientToServer::AdminPlay;
+    static constexpr std::string_view Command = "ADMIN_PLAY";
+    static constexpr auto fields() { return std::make_tuple(); }
+};
+
+// A fresh roster snapshot, for a client that saw a gap in the versions
+struct RequestRoster
+{
+    static constexpr auto Type = MessageTypeClientToServer::RequestRoster;
+    static constexpr std::string_view Command = "REQUEST_ROSTER";
+    static constexpr auto fields() { return std::make_tuple(); }
+};
+}
+
+namespace ToClient
+{
+struct Welcome
+{
+    static constexpr auto Type = MessageTypeServerToClient::Welcome;
+    static constexpr std::string_view Command = "WELCOME";
+    int playerId = -1;
+    std::string_view name;
+    static constexpr auto fields() { return std::make_tuple(&Welcome::playerId, &Welcome::name); }
+};
+
+// Roster deltas, see Roster
+struct PlayerJoined
+{
+    static constexpr auto Type = MessageTypeServerToClient::PlayerJoined;
+    static constexpr std::string_view Command = "PLAYER_JOINED";
+    int version = 0;
+    int playerId = -1;
+    std::string_view name;
+    static constexpr auto fields() { return std::make_tuple(&PlayerJoined::version, &PlayerJoined::playerId, &PlayerJoined::name); }
+};
+
+struct PlayerLeft
+{
+    static constexpr auto Type = MessageTypeServerToClient::PlayerLeft;
+    static constexpr std::string_view Command = "PLAYER_LEFT";
+    int version = 0;
+    int playerId = -1;
+    static constexpr auto fields() { return std::make_tuple(&PlayerLeft::version, &PlayerLeft::playerId); }
+};
+
+struct PlayerReady
+{
+    static constexpr auto Type = MessageTypeServerToClient::PlayerReady;
+    static constexpr std::string_view Command = "PLAYER_READY";
+    int playerId = -1;
+    static constexpr auto fields() { return std::make_tuple(&PlayerReady::playerId); }
+};
+
+struct ChatFrom
+{
+    static constexpr auto Type = MessageTypeServerToClient::ChatFrom;
+    static constexpr std::string_view Command = "CHAT_FROM";
+    int playerId = -1;
+    std::string_view text;
+    static constexpr auto fields() { return std::make_tuple(&ChatFrom::playerId, &ChatFrom::text); }
+};
+
+struct GameState
+{
+    static constexpr auto Type = MessageTypeServerToClient::GameState;
+    static constexpr std::string_view Command = "GAME_STATE";
+    ::GameState state = ::GameState::WaitingForPlayers;
+    int pot = 0;
+    static constexpr auto fields() { return std::make_tuple(&GameState::state, &GameState::pot); }
+};
+
+struct ActionResult
 {
-    std::ostringstream out;
+    static constexpr auto Type = MessageTypeServerToClient::ActionResult;
+    static constexpr std::string_view Command = "ACTION_RESULT";
+    int playerId = -1;
+    PlayerActionType action = PlayerActionType::Failed;
+    int amount = 0;
+    static constexpr auto fields() { return std::make_tuple(&ActionResult::playerId, &ActionResult::action, &ActionResult::amount); }
+};
 
-    switch (m.type)
+struct BettingUpdate
+{
+    static constexpr auto Type = MessageTypeServerToClient::BettingUpdate;
+    static constexpr std::string_view Command = "BETTING_UPDATE";
+    int toAct = -1;
+    int toCall = 0;
+    int currentBet = 0;
+    int minRaise = 0;
+    int pot = 0;
+    static constexpr auto fields()
     {
-    case MessageTypeClientToServer::Join:
-        out << "JOIN " << m.name;
-        break;
-    case MessageTypeClientToServer::Ready:
-        out << "READY";
-        break;
-    case MessageTypeClientToServer::Chat:
-        out << "CHAT " << m.chatText;
-        break;
-    case MessageTypeClientToServer::Action:
-        out << "ACTION " << int(m.action) << " " << m.actionAmount;
-        break;
-    case MessageTypeClientToServer::RequestState:
-        out << "REQUEST_STATE ";
-        break;
-    case MessageTypeClientToServer::Leave:
-        out << "LEAVE ";
-        break;
-    case MessageTypeClientToServer::AdminPlay:
-        out << "ADMIN_PLAY ";
-        break;
-    default:
-        break;
+        return std::make_tuple(&BettingUpdate::toAct, &BettingUpdate::toCall, &BettingUpdate::currentBet, &BettingUpdate::minRaise,
+                               &BettingUpdate::pot);
     }
-    out << "\n";
+};
+
+struct CommunityCard
+{
+    static constexpr auto Type = MessageTypeServerToClient::CommunityCard;
+    static constexpr std::string_view Command = "COMMUNITY_CARD";
+    CardIndex card = NoCard;
+    static constexpr auto fields() { return std::make_tuple(&CommunityCard::card); }
+};
+
+struct PlayerHand
+{
+    static constexpr auto Type = MessageTypeServerToClient::PlayerHand;
+    static constexpr std::string_view Command = "PLAYER_HAND";
+    int playerId = -1;
+    CardIndex card = NoCard;
+    static constexpr auto fields() { return std::make_tuple(&PlayerHand::playerId, &PlayerHand::card); }
+};
 
-    return out.str();
+struct PotUpdate
+{
+    static constexpr auto Type = MessageTypeServerToClient::PotUpdate;
+    static constexpr std::string_view Command = "POT_UPDATE";
+    int pot = 0;
+    static constexpr auto fields() { return std::make_tuple(&PotUpdate::pot); }
+};
+
+struct Showdown
+{
+    static constexpr auto Type = MessageTypeServerToClient::Showdown;
+    static constexpr std::string_view Command = "SHOWDOWN";
+    int pot = 0;
+    FixedList<WinnerShare, MaxSeats> winners;
+    static constexpr auto fields() { return std::make_tuple(&Showdown::pot, &Showdown::winners); }
+};
+
+struct AllInEquity
+{
+    static constexpr auto Type = MessageTypeServerToClient::AllInEquity;
+    static constexpr std::string_view Command = "ALL_IN_EQUITY";
+    FixedList<PlayerEquity, MaxSeats> players;
+    static constexpr auto fields() { return std::make_tuple(&AllInEquity::players); }
+};
+
+// Who is in the lobby and their chips as of roster version, sent once to a player after their
+// Welcome (or on REQUEST_ROSTER), RosterChunk players at a time; offset 0 starts a new snapshot.
+// After that the roster only changes through PlayerJoined/PlayerLeft, each carrying the next
+// version, so a client drops the deltas its snapshot already has and notices a gap.
+struct Roster
+{
+    static constexpr auto Type = MessageTypeServerToClient::Roster;
+    static constexpr std::string_view Command = "ROSTER";
+    int version = 0;
+    int offset = 0; // Of the first player in this chunk
+    FixedList<RosterEntry, RosterChunk> players;
+    static constexpr auto fields() { return std::make_tuple(&Roster::version, &Roster::offset, &Roster::players); }
+};
 }
 
-inline MessageClientToServer deserialize_client(const std::string &line)
+// In MessageType* order, so index() is the type
+using MessageClientToServer = std::variant<ToServer::Join, ToServer::Ready, ToServer::Chat, ToServer::Action, ToServer::RequestState,
+                                           ToServer::Leave, ToServer::AdminPlay, ToServer::RequestRoster>;
+
+using MessageServerToClient = std::variant<ToClient::Welcome, ToClient::PlayerJoined, ToClient::PlayerLeft, ToClient::PlayerReady,
+                                           ToClient::ChatFrom, ToClient::GameState, ToClient::ActionResult, ToClient::BettingUpdate,
+                                           ToClient::CommunityCard, ToClient::PlayerHand, ToClient::PotUpdate, ToClient::Showdown,
+                                           ToClient::AllInEquity, ToClient::Roster>;
+
+template <typename Variant, std::size_t... I>
+constexpr bool typesInOrder(std::index_sequence<I...>)
 {
-    std::istringstream in(line);
-    std::string command;
-    in >> command;
+    return ((std::size_t(std::variant_alternative_t<I, Variant>::Type) == I) && ...);
+}
+static_assert(typesInOrder<MessageClientToServer>(std::make_index_sequence<std::variant_size_v<MessageClientToServer>>()));
+static_assert(typesInOrder<MessageServerToClient>(std::make_index_sequence<std::variant_size_v<MessageServerToClient>>()));
+static_assert(std::is_trivially_copyable_v<MessageClientToServer> && std::is_trivially_copyable_v<MessageServerToClient>);
 
-    if (command.empty())
-        return MessageClientToServer{}; // Return default if command is empty
+inline MessageTypeClientToServer messageType(const MessageClientToServer &m)
+{
+    return MessageTypeClientToServer(m.index());
+}
 
-    MessageClientToServer msg;
+inline MessageTypeServerToClient messageType(const MessageServerToClient &m)
+{
+    return MessageTypeServerToClient(m.index());
+}
 
-    switch (command[0])
+// Text serialization appends to a caller-owned buffer with std::to_chars: once the buffer has grown
+// to fit the largest message, serializing allocates nothing. The returning overloads are for one-offs.
+// The codecs are constexpr so the schema can be checked at compile time, where to_chars/from_chars
+// aren't available yet; those paths do the digits by hand.
+constexpr void append_field(std::string &out, long long v)
+{
+    char digits[24] = {};
+    char *end = digits;
+    if (std::is_constant_evaluated())
     {
-    case 'J': // JOIN
-        msg.type = MessageTypeClientToServer::Join;
-        std::getline(in >> std::ws, msg.name);
-        break;
-    case 'R': // READY or REQUEST_STATE
-        if (command == "READY")
-            msg.type = MessageTypeClientToServer::Ready;
-        else
-            msg.type = MessageTypeClientToServer::RequestState;
-        break;
-    case 'C': // CHAT
-        msg.type = MessageTypeClientToServer::Chat;
-        std::getline(in >> std::ws, msg.chatText);
-        break;
-    case 'A': // ACTION
-        if (command == "ADMIN_PLAY")
+        unsigned long long magnitude = v < 0 ? 0ull - (unsigned long long)v : (unsigned long long)v;
+        char reversed[24] = {};
+        int n = 0;
+        do
         {
-            msg.type = MessageTypeClientToServer::AdminPlay;
-            break;
-        }
-        msg.type = MessageTypeClientToServer::Action;
-        int tempAction;
-        in >> tempAction >> msg.actionAmount;
-        msg.action = static_cast<PlayerActionType>(tempAction);
-        break;
-    case 'L': // LEAVE
-        msg.type = MessageTypeClientToServer::Leave;
-        break;
-    default:
-        break;
+            reversed[n++] = char('0' + magnitude % 10);
+            magnitude /= 10;
+        } while (magnitude);
+        if (v < 0)
+            *end++ = '-';
+        while (n)
+            *end++ = reversed[--n];
     }
-    return msg;
+    else
+        end = std::to_chars(digits, digits + sizeof(digits), v).ptr;
+    out.push_back(' ');
+    out.append(digits, std::size_t(end - digits));
 }
 
-inline std::string serialize_server(const MessageServerToClient &m)
+constexpr void append_field(std::string &out, std::string_view text)
 {
-    std::ostringstream out;
+    out.push_back(' ');
+    out.append(text);
+}
 
-    switch (m.type)
+// Text parsing works on a view of the line, straight out of the receive buffer, and reads numbers
+// with std::from_chars instead of locale-aware streams. A rejected line says why.
+enum class ParseError
+{
+    None,
+    Empty,           // Blank line
+    UnknownCommand,
+    MissingField,
+    BadNumber,       // Not a number, or out of range for its field
+    TrailingData,    // A complete message followed by more fields
+    ControlCharacter // In a string field, see isPlainText
+};
+
+constexpr const char *parse_error_name(ParseError error)
+{
+    switch (error)
     {
-    case MessageTypeServerToClient::Welcome:
-        out << "WELCOME " << m.playerId << " " << m.name << " " << m.playerSum;
-        for (auto it = m.playerNames.begin(); it != m.playerNames.end(); it++)
-        {
-            out << " " << it->first << " " << it->second;
-        }
-        for (auto it = m.playerMoney.begin(); it != m.playerMoney.end(); it++)
-        {
-            out << " " << it->first << " " << it->second;
-        }
-        break;
-    case MessageTypeServerToClient::PlayerJoined:
-        out << "PLAYER_JOINED " << m.playerId << " " << m.name;
-        break;
-    case MessageTypeServerToClient::PlayerLeft:
-        out << "PLAYER_LEFT " << m.playerId;
-        break;
-    case MessageTypeServerToClient::PlayerReady:
-        out << "PLAYER_READY " << m.playerId;
-        break;
-    case MessageTypeServerToClient::ChatFrom:
-        out << "CHAT_FROM " << m.playerId << " " << m.chatText;
-        break;
-    case MessageTypeServerToClient::GameState:
-        out << "GAME_STATE " << int(m.gameState);
-        out << " " << m.potAmount;
-        break;
-    case MessageTypeServerToClient::ActionResult:
-        out << "ACTION_RESULT " << m.playerId << " " << int(m.action) << " " << m.actionAmount;
-        break;
-    case MessageTypeServerToClient::CommunityCard:
-        out << "COMMUNITY_CARD " << m.cards;
-        break;
-    case MessageTypeServerToClient::PlayerHand:
-        out << "PLAYER_HAND " << m.playerId << " " << m.cards;
-        break;
-    case MessageTypeServerToClient::PotUpdate:
-        out << "POT_UPDATE " << m.potAmount;
-        break;
-    case MessageTypeServerToClient::Showdown:
-        out << "SHOWDOWN ";
-        out << m.potAmount << " " << m.idWinners.size();
-        ;
-        for (const auto &id : m.idWinners)
-        {
-            out << " " << id;
-        }
-        break;
-    case MessageTypeServerToClient::BettingUpdate:
-        out << "BETTING_UPDATE " << m.toAct << " " << m.toCall << " " << m.currentBet << " " << m.minRaise << " " << m.potAmount;
-        break;
-    default:
-        out << "UNKNOWN_MESSAGE";
-        break;
+    case ParseError::None:
+        return "ok";
+    case ParseError::Empty:
+        return "empty line";
+    case ParseError::UnknownCommand:
+        return "unknown command";
+    case ParseError::MissingField:
+        return "missing field";
+    case ParseError::BadNumber:
+        return "bad number";
+    case ParseError::TrailingData:
+        return "trailing data";
+    case ParseError::ControlCharacter:
+        return "control character";
     }
-    out << "\n";
-    return out.str();
+    return "?";
 }
 
-inline MessageServerToClient deserialize_server(const std::string &line)
+// Strings on the wire are plain text, tabs allowed. Anything else below space is refused on the
+// way in: a \n in a chat relayed from a binary client would end a text client's line early and
+// let the sender forge the next one.
+constexpr bool isPlainText(std::string_view s)
 {
-    std::istringstream in(line);
-    std::string command;
-    in >> command;
+    for (char c : s)
+    {
+        if ((std::uint8_t(c) < 0x20 && c != '\t') || c == 0x7F)
+            return false;
+    }
+    return true;
+}
 
-    if (command.empty())
-        return MessageServerToClient{}; // Return default if command is empty
+// A line without its \n, or the \r\n telnet sends
+constexpr std::string_view strip_line_end(std::string_view line)
+{
+    while (!line.empty() && (line.back() == '\n' || line.back() == '\r'))
+        line.remove_suffix(1);
+    return line;
+}
 
-    MessageServerToClient msg;
+// Reads the space-separated fields of one line. The first failure is kept in error and later reads
+// return empty/zero, so a parser reads everything and checks once at the end, like FrameReader.
+class TextReader
+{
+public:
+    constexpr explicit TextReader(std::string_view line) : line(strip_line_end(line)) {}
 
-    switch (command[0])
+    ParseError error = ParseError::None;
+
+    // The next field, empty at the end of the line
+    constexpr std::string_view word()
     {
-    case 'W': // WELCOME
-        msg.type = MessageTypeServerToClient::Welcome;
-        in >> msg.playerId >> msg.name >> msg.playerSum;
-        for (int i = 0; i < msg.playerSum; i++)
-        {
-            int id;
-            std::string name;
-            in >> id >> name;
-            msg.playerNames[id] = name;
-        }
-        for (int i = 0; i < msg.playerSum; i++)
-        {
-            int id;
-            int money;
-            in >> id >> money;
-            msg.playerMoney[id] = money;
-        }
-        break;
-    case 'P': // PLAYER_JOINED or PLAYER_LEFT or PLAYER_READY or PLAYER_HAND or POT_UPDATE
-        if (command == "PLAYER_JOINED")
-        {
-            msg.type = MessageTypeServerToClient::PlayerJoined;
-            in >> msg.playerId >> msg.name;
-        }
-        else if (command == "PLAYER_LEFT")
-        {
-            msg.type = MessageTypeServerToClient::PlayerLeft;
-            in >> msg.playerId;
-        }
-        else if (command == "PLAYER_READY")
-        {
-            msg.type = MessageTypeServerToClient::PlayerReady;
-            in >> msg.playerId;
-        }
-        else if (command == "PLAYER_HAND")
+        skipSpaces();
+        std::size_t end = pos;
+        while (end < line.size() && line[end] != ' ' && line[end] != '\t')
+            end++;
+        std::string_view w = line.substr(pos, end - pos);
+        pos = end;
+        return w;
+    }
+
+    // A field that has to be there
+    constexpr std::string_view field()
+    {
+        std::string_view w = word();
+        if (w.empty())
+            fail(ParseError::MissingField);
+        else if (!isPlainText(w))
+            fail(ParseError::ControlCharacter);
+        return error == ParseError::None ? w : std::string_view();
+    }
+
+    constexpr int integer(int lowest = std::numeric_limits<int>::min(), int highest = std::numeric_limits<int>::max())
+    {
+        std::string_view w = field();
+        if (error != ParseError::None)
+            return 0;
+        long long v = 0;
+        bool ok = true;
+        if (std::is_constant_evaluated())
         {
-            msg.type = MessageTypeServerToClient::PlayerHand;
-            in >> msg.playerId >> msg.cards;
+            std::size_t i = w[0] == '-' ? 1 : 0;
+            ok = i < w.size();
+            for (; ok && i < w.size() && v <= std::numeric_limits<int>::max(); i++)
+            {
+                ok = w[i] >= '0' && w[i] <= '9';
+                v = v * 10 + (w[i] - '0');
+            }
+            ok = ok && i == w.size();
+            v = w[0] == '-' ? -v : v;
         }
         else
         {
-            msg.type = MessageTypeServerToClient::PotUpdate;
-            in >> msg.potAmount;
-        }
-        break;
-    case 'C': // CHAT_FROM or COMMUNITY_CARD
-        if (command == "CHAT_FROM")
-        {
-            msg.type = MessageTypeServerToClient::ChatFrom;
-            in >> msg.playerId;
-            std::getline(in >> std::ws, msg.chatText);
+            int parsed = 0;
+            auto [end, ec] = std::from_chars(w.data(), w.data() + w.size(), parsed);
+            ok = ec == std::errc() && end == w.data() + w.size();
+            v = parsed;
         }
-        else
+        if (!ok || v < lowest || v > highest)
         {
-            msg.type = MessageTypeServerToClient::CommunityCard;
-            in >> msg.cards;
+            fail(ParseError::BadNumber);
+            return 0;
         }
-        break;
-    case 'G': // GAME_STATE
-        msg.type = MessageTypeServerToClient::GameState;
-        int tempState;
-        in >> tempState;
-        msg.gameState = static_cast<GameState>(tempState);
-        in >> msg.potAmount;
-        break;
-    case 'A': // ACTION_RESULT
-        msg.type = MessageTypeServerToClient::ActionResult;
-        int tempAction;
-        in >> msg.playerId >> tempAction >> msg.actionAmount;
-        msg.action = static_cast<PlayerActionType>(tempAction);
-        break;
-    case 'S': // SHOWDOWN
-        msg.type = MessageTypeServerToClient::Showdown;
-        int numWinners;
-        in >> msg.potAmount >> numWinners;
-        for (int i = 0; i < numWinners; i++)
+        return int(v);
+    }
+
+    // Everything left on the line, e.g. a chat message
+    constexpr std::string_view rest()
+    {
+        skipSpaces();
+        std::string_view r = line.substr(pos);
+        pos = line.size();
+        if (!isPlainText(r))
         {
-            int id;
-            in >> id;
-            msg.idWinners.push_back(id);
+            fail(ParseError::ControlCharacter);
+            return {};
         }
-        break;
-    case 'B': // BETTING_UPDATE
-        msg.type = MessageTypeServerToClient::BettingUpdate;
-        in >> msg.toAct >> msg.toCall >> msg.currentBet >> msg.minRaise >> msg.potAmount;
-        break;
-    default:
-        break;
+        return r;
     }
-    return msg;
-}
 
-inline void send_message_client(tcp::socket &socket, const MessageClientToServer &msg)
-{
-    try
+    constexpr bool atEnd()
     {
-        std::string serialized = serialize_client(msg);
-        boost::asio::write(socket, boost::asio::buffer(serialized));
+        skipSpaces();
+        return pos == line.size();
     }
-    catch (const std::exception &e)
+
+    // The parse result once every field has been read
+    constexpr ParseError finish()
     {
-        std::cerr << "Error sending message: " << e.what() << std::endl;
+        if (error == ParseError::None && !atEnd())
+            error = ParseError::TrailingData;
+        return error;
     }
-}
 
-inline MessageClientToServer receive_message_from_client(tcp::socket &socket)
-{
-    std::string line = "";
-    try
+private:
+    std::string_view line;
+    std::size_t pos = 0;
+
+    constexpr void skipSpaces()
+    {
+        while (pos < line.size() && (line[pos] == ' ' || line[pos] == '\t'))
+            pos++;
+    }
+
+    constexpr void fail(ParseError e)
     {
-        boost::asio::streambuf buf;
-        boost::asio::read_until(socket, buf, '\n');
-        std::istream is(&buf);
-        std::getline(is, line);
+        if (error == ParseError::None)
+            error = e;
     }
-    catch (const std::exception &e)
+};
+
+template <typename T>
+constexpr bool isFixedList = false;
+template <typename T, std::size_t N>
+constexpr bool isFixedList<FixedList<T, N>> = true;
+
+// Highest value of each enum that goes on the wire
+constexpr int lastValue(PlayerActionType) { return int(PlayerActionType::Failed); }
+constexpr int lastValue(GameState) { return int(GameState::Showdown); }
+
+// Field by field from fields(). Numbers and enums are decimal, a uint8_t is a card, a list is its
+// count and then its items.
+template <typename T>
+constexpr void write_text_field(std::string &out, const T &value)
+{
+    if constexpr (std::is_same_v<T, std::string_view>)
+        append_field(out, value);
+    else if constexpr (std::is_enum_v<T> || std::is_integral_v<T>)
+        append_field(out, (long long)value);
+    else if constexpr (isFixedList<T>)
     {
-        std::cerr << "Error receiving message: " << e.what() << std::endl;
-        throw; // Re-raise the exception to signal an error condition
+        append_field(out, (long long)value.size());
+        for (const auto &item : value)
+            write_text_field(out, item);
     }
-    return deserialize_client(line);
+    else
+        std::apply([&](auto... field)
+                   { (write_text_field(out, value.*field), ...); },
+                   T::fields());
 }
 
-inline void send_message_server(tcp::socket &socket, const MessageServerToClient &msg)
+// rest: the string is the message's last field, so it takes the rest of the line, spaces and all
+template <typename T>
+constexpr void read_text_field(TextReader &in, T &value, bool rest = false)
 {
-    try
+    if constexpr (std::is_same_v<T, std::string_view>)
+        value = rest ? in.rest() : in.field();
+    else if constexpr (std::is_same_v<T, CardIndex>)
     {
-        std::string serialized = serialize_server(msg);
-        boost::asio::write(socket, boost::asio::buffer(serialized));
+        int card = in.integer();
+        value = isValidCard(card) ? CardIndex(card) : NoCard;
     }
-    catch (const std::exception &e)
+    else if constexpr (std::is_enum_v<T>)
+        value = T(in.integer(0, lastValue(T{})));
+    else if constexpr (std::is_integral_v<T>)
+        value = in.integer();
+    else if constexpr (isFixedList<T>)
     {
-        std::cerr << "Error sending message: " << e.what() << std::endl;
+        value.count = std::uint8_t(in.integer(0, int(T::Capacity)));
+        for (std::size_t i = 0; i < value.count && in.error == ParseError::None; i++)
+            read_text_field(in, value.items[i]);
     }
+    else
+        std::apply([&](auto... field)
+                   { (read_text_field(in, value.*field), ...); },
+                   T::fields());
 }
 
-inline MessageServerToClient receive_message_from_server(tcp::socket &socket)
+template <typename Msg>
+constexpr void write_text_message(const Msg &msg, std::string &out)
 {
-    std::string line = "";
-    try
+    out += Msg::Command;
+    write_text_field(out, msg);
+    out += '\n';
+}
+
+// in is past the command
+template <typename Msg>
+constexpr ParseError read_text_message(TextReader &in, Msg &msg)
+{
+    constexpr std::size_t count = std::tuple_size_v<decltype(Msg::fields())>;
+    [&]<std::size_t... I>(std::index_sequence<I...>)
     {
-        boost::asio::streambuf buf;
-        boost::asio::read_until(socket, buf, '\n');
-        std::istream is(&buf);
-        std::getline(is, line);
+        (read_text_field(in, msg.*std::get<I>(Msg::fields()), I + 1 == count), ...);
+    }(std::make_index_sequence<count>());
+    return in.finish();
+}
+
+// Text commands are looked up with a perfect hash found at compile time: hashing the command gives
+// the only message it can be, one compare confirms it. No chain of compares, and a new message
+// doesn't slow down the others.
+constexpr std::uint32_t commandHash(std::string_view command, std::uint32_t seed)
+{
+    std::uint32_t h = seed; // FNV-1a
+    for (char c : command)
+        h = (h ^ std::uint8_t(c)) * 16777619u;
+    return h;
+}
+
+template <typename Variant>
+struct CommandTable
+{
+    static constexpr std::size_t Count = std::variant_size_v<Variant>;
+    static constexpr std::size_t Size = 64; // Slots, a power of two
+    static_assert(Count < Size / 2);
+
+    static constexpr auto commands = []<std::size_t... I>(std::index_sequence<I...>)
+    {
+        return std::array<std::string_view, Count>{std::variant_alternative_t<I, Variant>::Command...};
+    }(std::make_index_sequence<Count>());
+
+    static constexpr bool collisionFree(std::uint32_t seed)
+    {
+        std::array<bool, Size> used{};
+        for (std::string_view command : commands)
+        {
+            std::size_t slot = commandHash(command, seed) & (Size - 1);
+            if (used[slot])
+                return false;
+            used[slot] = true;
+        }
+        return true;
+    }
+
+    static constexpr std::uint32_t findSeed()
+    {
+        for (std::uint32_t seed = 2166136261u; seed < 2166136261u + 100000; seed++)
+        {
+            if (collisionFree(seed))
+                return seed;
+        }
+        return 0;
     }
-    catch (const std::exception &e)
+
+    static constexpr std::uint32_t Seed = findSeed();
+    static_assert(Seed != 0, "no collision-free seed for these commands, make Size bigger");
+
+    static constexpr auto slots = []()
     {
-        std::cerr << "Error receiving message: " << e.what() << std::endl;
-        throw; // Re-raise the exception to signal an error condition
+        std::array<std::uint8_t, Size> table{}; // Message index + 1, 0 for none
+        for (std::size_t i = 0; i < Count; i++)
+            table[commandHash(commands[i], Seed) & (Size - 1)] = std::uint8_t(i + 1);
+        return table;
+    }();
+
+    // Index of the message with this command, -1 if there's none
+    static constexpr int find(std::string_view command)
+    {
+        std::uint8_t entry = slots[commandHash(command, Seed) & (Size - 1)];
+        return entry != 0 && commands[entry - 1] == command ? entry - 1 : -1;
     }
-    return deserialize_server(line);
+};
+
+template <typename Variant>
+constexpr void write_text(const Variant &m, std::string &out)
+{
+    std::visit([&out](const auto &msg)
+               { write_text_message(msg, out); },
+               m);
 }
 
-static inline void trim(std::string &s)
+template <typename Variant, std::size_t I>
+ParseError read_text_alternative(TextReader &in, Variant &msg)
 {
-    if (!s.empty() && s.back() == '\r')
-        s.pop_back();
-}
\ No newline at end of file
+    return read_text_message(in, msg.template emplace<I>());
+}
+
+// Strings in msg point into line. On an error msg holds whatever was read before it.
+template <typename Variant>
+ParseError read_text(std::string_view line, Variant &msg)
+{
+    static constexpr auto readers = []<std::size_t... I>(std::index_sequence<I...>)
+    {
+        return std::array<ParseError (*)(TextReader &, Variant &), sizeof...(I)>{&read_text_alternative<Variant, I>...};
+    }(std::make_index_sequence<std::variant_size_v<Variant>>());
+
+    TextReader in(line);
+    std::string_view command = in.word();
+    if (command.empty())
+        return ParseError::Empty;
+    int index = CommandTable<Variant>::find(command);
+    if (index < 0)
+        return ParseError::UnknownCommand;
+    return readers[index](in, msg);
+}
+
+inline void serialize_client(const MessageClientToServer &m, std::string &out)
+{
+    write_text(m, out);
+}
+
+inline std::string serialize_client(const MessageClientToServer &m)
+{
+    std::string out;
+    write_text(m, out);
+    return out;
+}
+
+inline ParseError parse_client(std::string_view line, MessageClientToServer &msg)
+{
+    return read_text(line, msg);
+}
+
+// Strings in the result point into line
+inline MessageClientToServer deserialize_client(std::string_view line)
+{
+    MessageClientToServer msg;
+    parse_client(line, msg);
+    return msg;
+}
+
+inline void serialize_server(const MessageServerToClient &m, std::string &out)
+{
+    write_text(m, out);
+}
+
+inline std::string serialize_server(const MessageServerToClient &m)
+{
+    std::string out;
+    write_text(m, out);
+    return out;
+}
+
+inline ParseError parse_server(std::string_view line, MessageServerToClient &msg)
+{
+    return read_text(line, msg);
+}
@@ -73,6 +73,9 @@ void Game::input()
 
     if (IsKeyPressed(KEY_ENTER))
         client.sendAction(PlayerActionType::Raise, raiseAmount);
+
+    if (IsKeyPressed(KEY_E))
+        client.estimateEquity(); // Shows up in the state when it's done
 }
 
 void Game::update()
@@ -118,6 +121,13 @@ void Game::draw()
     DrawText("C = Call", 20, 390, 20, YELLOW);
     DrawText("1/2 = Increase Raise", 20, 420, 20, YELLOW);
     DrawText("ENTER = Raise", 20, 450, 20, YELLOW);
-
-    DrawText(TextFormat("Raise Amount: %d", raiseAmount), 20, 500, 24, ORANGE);
+    DrawText("E = Equity", 20, 480, 20, YELLOW);
+
+    DrawText(TextFormat("Raise Amount: %d", raiseAmount), 20, 520, 24, ORANGE);
+    if (currentState.myEquity >= 0)
+        DrawText(TextFormat("Equity: %.1f%%", currentState.myEquity * 100.0), 20, 550, 24, ORANGE);
+    if (currentState.madeHand.size() >= 5)
+        DrawText(TextFormat("Hand: %s", categoryName(categoryOf(currentState.madeHand.rank()))), 20, 610, 24, ORANGE);
+    if (currentState.allInEquity >= 0)
+        DrawText(TextFormat("All-in Equity: %.1f%%", currentState.allInEquity / 10.0), 20, 580, 24, ORANGE);
 }
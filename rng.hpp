@@ -0,0 +1,106 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <random>
+
+// Small, fast, seedable random numbers for shuffling and simulations.
+//
+// Xoshiro256 is xoshiro256** (Blackman & Vigna): 32 bytes of state, a few ns per number and good
+// enough statistically for cards. It models UniformRandomBitGenerator, so std::shuffle and the
+// <random> distributions take it too. Every table or worker gets its own generator from
+// forStream(masterSeed, stream), so one logged master seed replays a whole session and no
+// generator is ever shared between threads.
+
+inline std::uint64_t splitMix64(std::uint64_t &state)
+{
+    std::uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+inline std::uint64_t randomSeed()
+{
+    std::random_device device;
+    return std::uint64_t(device()) << 32 | device();
+}
+
+class Xoshiro256
+{
+public:
+    using result_type = std::uint64_t;
+
+    explicit Xoshiro256(std::uint64_t seed = 0)
+    {
+        // SplitMix64 spreads any seed, 0 included, over the state; it never comes out all zero
+        for (auto &word : s)
+            word = splitMix64(seed);
+    }
+
+    // Generator number `stream` of a session. Distinct streams start from unrelated states.
+    static Xoshiro256 forStream(std::uint64_t masterSeed, std::uint64_t stream)
+    {
+        std::uint64_t mixed = masterSeed ^ (stream * 0xD1B54A32D192ED03ull);
+        return Xoshiro256(splitMix64(mixed));
+    }
+
+    // Raw state, for snapshots. fromState rejects the all-zero state, which would only ever give zeros.
+    std::array<std::uint64_t, 4> state() const
+    {
+        return {s[0], s[1], s[2], s[3]};
+    }
+
+    static Xoshiro256 fromState(const std::array<std::uint64_t, 4> &state)
+    {
+        Xoshiro256 rng;
+        if (state[0] | state[1] | state[2] | state[3])
+        {
+            for (int i = 0; i < 4; i++)
+                rng.s[i] = state[i];
+        }
+        return rng;
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    result_type operator()()
+    {
+        const std::uint64_t result = rotl(s[1] * 5, 7) * 9;
+        const std::uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+    }
+
+    // Uniform in [0, range) without modulo bias (Lemire's multiply-and-reject); range must be > 0.
+    // Only rejects when the low half of the product lands in the first 2^32 mod range values.
+    std::uint32_t bounded(std::uint32_t range)
+    {
+        std::uint64_t product = std::uint64_t(std::uint32_t((*this)() >> 32)) * range;
+        std::uint32_t low = std::uint32_t(product);
+        if (low < range)
+        {
+            std::uint32_t threshold = (0u - range) % range;
+            while (low < threshold)
+            {
+                product = std::uint64_t(std::uint32_t((*this)() >> 32)) * range;
+                low = std::uint32_t(product);
+            }
+        }
+        return std::uint32_t(product >> 32);
+    }
+
+private:
+    std::uint64_t s[4];
+
+    static std::uint64_t rotl(std::uint64_t x, int k)
+    {
+        return (x << k) | (x >> (64 - k));
+    }
+};
@@ -1,13 +1,20 @@
 #include "poker_networking.hpp"
 #include "client_in_server.hpp"
 #include "deck.h"
+#include <filesystem>
+#include <optional>
 using namespace std;
 
 class Server
 {
 public:
-    Server()
+    // One Xoshiro256 stream per table, all derived from the session seed so a logged seed replays every deal
+    // checkpointPath: where to save the table whenever it waits on a player, empty for nowhere.
+    // resume: a hand to pick up once its players have rejoined (see resumeHand).
+    explicit Server(uint64_t seed, string checkpointPath = {}, optional<TableSnapshot> resume = {})
+        : deck(FullDeckMask, Xoshiro256::forStream(seed, 0)), checkpointPath(move(checkpointPath)), pendingRestore(resume)
     {
+        cout << "Session seed: " << seed << "\n";
         start();
     }
     ~Server()
@@ -85,6 +92,13 @@ public:
             cout << "Not all players are ready.\n";
             return;
         }
+        if (state.clients.size() > size_t(MaxSeats))
+        {
+            cout << "Too many players for one table (at most " << MaxSeats << ").\n";
+            return;
+        }
+        if (pendingRestore && resumeHand())
+            return;
 
         state.pot = 0;
         state.gameState = GameState::PreFlop;
@@ -93,15 +107,13 @@ public:
         state.needsAction.clear();
 
         state.handstate.clear();
+        state.handstate.handId++;
+        deck.Reset();
         state.handstate.active = true;
         state.handstate.street = 0;
 
-        state.broadcast_all(serialize_server(MessageServerToClient{
-            .type = MessageTypeServerToClient::GameState,
-            .gameState = state.gameState}));
-        state.broadcast_all(serialize_server(MessageServerToClient{
-            .type = MessageTypeServerToClient::PotUpdate,
-            .potAmount = state.pot}));
+        state.broadcast_all(ToClient::GameState{state.gameState, state.pot});
+        state.broadcast_all(ToClient::PotUpdate{state.pot});
 
         for (auto &client : players)
         {
@@ -112,6 +124,7 @@ public:
         }
 
         state.handstate.hole.resize(players.size());
+        state.handstate.committed.assign(players.size(), 0);
 
         cout << "All players are ready. Starting game...\n";
 
@@ -121,7 +134,7 @@ public:
             for (size_t j = 0; j < players.size(); j++)
             {
                 auto card = deck.DrawCard();
-                cout << "Dealt card " << card.value << " of suit " << card.suit << " to player " << players[j]->display_name() << endl;
+                cout << "Dealt card " << cardValue(card) << " of suit " << cardSuit(card) << " to player " << players[j]->display_name() << endl;
                 if (round == 0)
                 {
                     state.handstate.hole[j].first = card;
@@ -130,10 +143,7 @@ public:
                 {
                     state.handstate.hole[j].second = card;
                 }
-                state.broadcast_all(serialize_server(MessageServerToClient{
-                    .type = MessageTypeServerToClient::PlayerHand,
-                    .playerId = players[j]->id,
-                    .cards = to_string(card.value) + "," + to_string(card.suit)}));
+                state.broadcast_all(ToClient::PlayerHand{players[j]->id, card});
             }
         }
         state.gameState = GameState::PreFlop;
@@ -186,18 +196,17 @@ public:
                 }
             }
             state.gameState = GameState::Showdown;
-            state.broadcast_all(serialize_server(MessageServerToClient{
-                .type = MessageTypeServerToClient::Showdown,
-                .potAmount = state.pot,
-                .idWinners = {winnerId}}));
+            ToClient::Showdown showdown;
+            showdown.pot = state.pot;
+            showdown.winners.push_back({winnerId, state.pot});
+            state.broadcast_all(showdown);
 
             return;
         }
 
         if (CountCanAct() == 0 && countInHand() > 1)
         {
-            runOutToFive();
-            doShowdown();
+            runOutAllIn();
             return;
         }
 
@@ -243,18 +252,19 @@ public:
         if (!p)
             return;
 
+        checkpoint();
+
         int toCall = max(0, state.currentBet - p->betThisRound);
 
         cout << "Next to act: " << state.toAct << " toCall=" << toCall << " currentBet=" << state.currentBet << " minRaise=" << state.minRaise << "\n";
 
-        state.broadcast_all(serialize_server(MessageServerToClient{
-            .type = MessageTypeServerToClient::BettingUpdate,
-            .potAmount = state.pot,
+        state.broadcast_all(ToClient::BettingUpdate{
             .toAct = state.toAct,
             .toCall = toCall,
             .currentBet = state.currentBet,
             .minRaise = state.minRaise,
-        }));
+            .pot = state.pot,
+        });
     }
     void onPlayerAction(int playerId, PlayerActionType action, int actionAmount)
     {
@@ -262,12 +272,7 @@ public:
         {
             auto it = state.idToName.find(playerId);
             cout << "Received action from player " << (it != state.idToName.end() ? it->second : "Unknown") << " but it's not their turn.\n";
-            state.send_to(serialize_server(MessageServerToClient{
-                              .type = MessageTypeServerToClient::ActionResult,
-                              .playerId = playerId,
-                              .action = PlayerActionType::Failed,
-                              .actionAmount = 0}),
-                          playerId);
+            state.send_to(ToClient::ActionResult{.playerId = playerId, .action = PlayerActionType::Failed, .amount = 0}, playerId);
             return;
         }
         auto p = find_client_by_id(playerId);
@@ -292,6 +297,10 @@ public:
             p->money -= act;
             p->betThisRound += act;
             state.pot += act;
+            auto &order = state.handstate.playersOrderd;
+            auto seat = find(order.begin(), order.end(), p->id);
+            if (seat != order.end())
+                state.handstate.committed[seat - order.begin()] += act;
             if (p->money == 0)
                 p->allin = true;
             return act;
@@ -356,21 +365,191 @@ public:
             ok = false;
             break;
         }
-        state.broadcast_all(serialize_server(MessageServerToClient{
-            .type = MessageTypeServerToClient::ActionResult,
+        state.broadcast_all(ToClient::ActionResult{
             .playerId = playerId,
-            .potAmount = state.pot,
             .action = ok ? action : PlayerActionType::Failed,
-            .actionAmount = actionAmount,
-        }));
+            .amount = actionAmount,
+        });
         cout << "Player " << p->display_name() << " performed action " << int(action) << " with amount " << actionAmount << (ok ? "" : " (invalid)") << ". Pot is now " << state.pot << ".\n";
         AdvanceBetting();
     }
 
+    // Whole table as a fixed-layout record, see snapshot.hpp
+    TableSnapshot snapshot()
+    {
+        TableSnapshot snap = emptySnapshot();
+        const HandState &hs = state.handstate;
+        snap.handId = hs.handId;
+        snap.pot = state.pot;
+        snap.currentBet = state.currentBet;
+        snap.minRaise = state.minRaise;
+        snap.lastAggressor = state.lastAggressor;
+        snap.toAct = state.toAct;
+        snap.toCall = state.toCall;
+        snap.active = hs.active;
+        snap.street = uint8_t(hs.street);
+        snap.gameState = uint8_t(state.gameState);
+        snap.boardCount = uint8_t(hs.communityCards.size());
+        for (size_t i = 0; i < hs.communityCards.size(); i++)
+            snap.board[i] = hs.communityCards[i];
+        snap.deck = deck.Snapshot();
+
+        snap.seatCount = uint8_t(min<size_t>(hs.playersOrderd.size(), MaxSeats));
+        for (int j = 0; j < snap.seatCount; j++)
+        {
+            SeatSnapshot &seat = snap.seats[j];
+            seat.id = hs.playersOrderd[j];
+            seat.committed = hs.committed[j];
+            seat.hole[0] = hs.hole[j].first;
+            seat.hole[1] = hs.hole[j].second;
+            if (auto c = find_client_by_id(seat.id))
+            {
+                seat.betThisRound = c->betThisRound;
+                seat.money = c->money;
+                seat.flags = (c->inHand ? SeatInHand : 0) | (c->allin ? SeatAllIn : 0) |
+                             (state.needsAction.count(seat.id) ? SeatNeedsAction : 0);
+            }
+        }
+        return snap;
+    }
+
+    // Puts a snapshot back. Seats are matched to connected clients by id; seats whose player
+    // isn't connected keep their cards and chips in the hand but can't act. False, with nothing
+    // changed, if the deck or the cards of a hand in progress don't add up.
+    bool restore(const TableSnapshot &snap)
+    {
+        if (snap.active && !handCardsValid(snap))
+            return false;
+        if (!deck.Restore(snap.deck))
+            return false;
+
+        HandState &hs = state.handstate;
+        hs.clear();
+        hs.handId = snap.handId;
+        hs.active = snap.active;
+        hs.street = snap.street;
+        if (snap.active) // Outside a hand the cards are leftovers nobody checked
+            hs.communityCards.assign(snap.board, snap.board + snap.boardCount);
+
+        state.pot = snap.pot;
+        state.currentBet = snap.currentBet;
+        state.minRaise = snap.minRaise;
+        state.lastAggressor = snap.lastAggressor;
+        state.toAct = snap.toAct;
+        state.toCall = snap.toCall;
+        state.gameState = GameState(snap.gameState);
+        state.needsAction.clear();
+
+        for (int j = 0; j < snap.seatCount; j++)
+        {
+            const SeatSnapshot &seat = snap.seats[j];
+            hs.playersOrderd.push_back(seat.id);
+            hs.hole.push_back(snap.active ? hand{seat.hole[0], seat.hole[1]} : hand{NoCard, NoCard});
+            hs.committed.push_back(seat.committed);
+            if (auto c = find_client_by_id(seat.id))
+            {
+                c->betThisRound = seat.betThisRound;
+                c->money = seat.money;
+                c->inHand = seat.flags & SeatInHand;
+                c->allin = seat.flags & SeatAllIn;
+                if (seat.flags & SeatNeedsAction)
+                    state.needsAction.insert(seat.id);
+            }
+        }
+        return true;
+    }
+
+    // Picks up the hand from --restore: puts it back and resends everything a client needs to show
+    // it. Players get their ids in the order they connect, so they have to rejoin in the order they
+    // first joined. True if play_game has nothing more to do, which is also the case while players
+    // are missing; false to deal a new hand (the snapshot wasn't in a hand, only chips came back).
+    bool resumeHand()
+    {
+        const TableSnapshot &snap = *pendingRestore;
+        for (int j = 0; j < snap.seatCount; j++)
+        {
+            if (!find_client_by_id(snap.seats[j].id))
+            {
+                cout << "Waiting for player " << snap.seats[j].id << " to rejoin before resuming hand " << snap.handId << ".\n";
+                return true;
+            }
+        }
+        bool restored = restore(snap);
+        pendingRestore.reset();
+        if (!restored)
+        {
+            cout << "The saved hand's cards are not valid, dealing a new hand instead.\n";
+            return false;
+        }
+        if (!state.handstate.active)
+            return false;
+
+        cout << "Resuming hand " << state.handstate.handId << ".\n";
+        const HandState &hs = state.handstate;
+        state.broadcast_all(ToClient::GameState{state.gameState, state.pot});
+        state.broadcast_all(ToClient::PotUpdate{state.pot});
+        for (size_t j = 0; j < hs.playersOrderd.size(); j++)
+        {
+            state.broadcast_all(ToClient::PlayerHand{hs.playersOrderd[j], hs.hole[j].first});
+            state.broadcast_all(ToClient::PlayerHand{hs.playersOrderd[j], hs.hole[j].second});
+        }
+        for (CardIndex card : hs.communityCards)
+            state.broadcast_all(ToClient::CommunityCard{card});
+        AdvanceBetting(); // Asks toAct again, it still needs to act
+        return true;
+    }
+
 private:
+    // With --checkpoint, saved whenever the table waits on a player, so a crash loses at most the
+    // action in flight. Only the snapshot is taken here; a worker writes it out. Snapshots taken
+    // while a write is going replace each other, so the file ends up with the latest.
+    void checkpoint()
+    {
+        if (checkpointPath.empty())
+            return;
+        TableSnapshot snap = snapshot();
+        lock_guard<mutex> lock(checkpointMutex);
+        pendingCheckpoint = snap;
+        if (checkpointWriting)
+            return;
+        checkpointWriting = true;
+        workers.post([this]()
+                     { writeCheckpoints(); });
+    }
+
+    void writeCheckpoints()
+    {
+        unique_lock<mutex> lock(checkpointMutex);
+        while (pendingCheckpoint)
+        {
+            TableSnapshot snap = *pendingCheckpoint;
+            pendingCheckpoint.reset();
+            lock.unlock();
+
+            // Written beside the last one and renamed over it, so a crash mid-write keeps the old one
+            string temp = checkpointPath + ".tmp";
+            error_code ec;
+            if (writeSnapshots(temp, &snap, 1))
+                filesystem::rename(temp, checkpointPath, ec);
+            else
+                ec = make_error_code(errc::io_error);
+            if (ec)
+                cout << "Could not write " << checkpointPath << ": " << ec.message() << "\n";
+
+            lock.lock();
+        }
+        checkpointWriting = false;
+    }
+
     boost::asio::io_context io;
     ServerState state;
     Deck deck;
+    string checkpointPath;
+    mutex checkpointMutex; // Guards pendingCheckpoint and checkpointWriting, shared with the writer
+    optional<TableSnapshot> pendingCheckpoint;
+    bool checkpointWriting = false;
+    optional<TableSnapshot> pendingRestore;
+    ThreadPool workers; // Last, so it finishes a checkpoint write before the rest goes away
 
     shared_ptr<Client> find_client_by_id(int id)
     {
@@ -419,20 +598,16 @@ private:
         {
             auto card = deck.DrawCard();
             state.handstate.communityCards.push_back(card);
-            cout << "Dealing community card " << card.value << " of suit " << card.suit << endl;
-            state.broadcast_all(serialize_server(MessageServerToClient{
-                .type = MessageTypeServerToClient::CommunityCard,
-                .cards = to_string(card.value) + "." + to_string(card.suit)}));
+            cout << "Dealing community card " << cardValue(card) << " of suit " << cardSuit(card) << endl;
+            state.broadcast_all(ToClient::CommunityCard{card});
         }
     }
     void dealTurnorRiver()
     {
         auto card = deck.DrawCard();
         state.handstate.communityCards.push_back(card);
-        cout << "Dealing community card " << card.value << " of suit " << card.suit << endl;
-        state.broadcast_all(serialize_server(MessageServerToClient{
-            .type = MessageTypeServerToClient::CommunityCard,
-            .cards = to_string(card.value) + "." + to_string(card.suit)}));
+        cout << "Dealing community card " << cardValue(card) << " of suit " << cardSuit(card) << endl;
+        state.broadcast_all(ToClient::CommunityCard{card});
     }
     void runOutToFive()
     {
@@ -440,50 +615,97 @@ private:
         {
             auto card = deck.DrawCard();
             state.handstate.communityCards.push_back(card);
-            cout << "Dealing community card " << card.value << " of suit " << card.suit << endl;
-            state.broadcast_all(serialize_server(MessageServerToClient{
-                .type = MessageTypeServerToClient::CommunityCard,
-                .cards = to_string(card.value) + "." + to_string(card.suit)}));
+            cout << "Dealing community card " << cardValue(card) << " of suit " << cardSuit(card) << endl;
+            state.broadcast_all(ToClient::CommunityCard{card});
         }
     }
 
+    // Betting is closed: work out every live player's exact equity over all remaining runouts on
+    // the worker pool, broadcast it, then deal the board back on the io thread
+    void runOutAllIn()
+    {
+        vector<int> ids;
+        vector<hand> hands;
+        for (size_t j = 0; j < state.handstate.playersOrderd.size(); j++)
+        {
+            auto c = find_client_by_id(state.handstate.playersOrderd[j]);
+            if (c && c->inHand)
+            {
+                ids.push_back(c->id);
+                hands.push_back(state.handstate.hole[j]);
+            }
+        }
+
+        int handId = state.handstate.handId;
+        enumerateEquityAsync(
+            workers, hands, state.handstate.communityCards, 0,
+            [this, ids, handId](EquityResult result)
+            {
+                boost::asio::post(
+                    io,
+                    [this, ids, handId, result = std::move(result)]()
+                    {
+                        if (handId != state.handstate.handId)
+                            return;
+                        EventBatch event(state);
+
+                        ToClient::AllInEquity msg;
+                        for (size_t i = 0; i < ids.size(); i++)
+                        {
+                            msg.players.push_back({ids[i], int(result.equity[i] * 1000 + 0.5)});
+                            cout << "Player " << findNameById(ids[i]) << " all-in equity " << result.equity[i] * 100 << "% over " << result.samples << " runouts\n";
+                        }
+                        state.broadcast_all(msg);
+
+                        runOutToFive();
+                        doShowdown();
+                    });
+            });
+    }
+
     void doShowdown()
     {
-        vector<hand> hands = state.handstate.hole;
-        vector<valRank> community = state.handstate.communityCards;
+        // Folded players keep their chips in the pots but aren't evaluated
+        vector<ShowdownSeat> seats;
+        for (size_t j = 0; j < state.handstate.playersOrderd.size(); j++)
+        {
+            auto c = find_client_by_id(state.handstate.playersOrderd[j]);
+            seats.push_back(ShowdownSeat{
+                .id = state.handstate.playersOrderd[j],
+                .committed = state.handstate.committed[j],
+                .live = c && c->inHand,
+                .hole = cardBit(state.handstate.hole[j].first) | cardBit(state.handstate.hole[j].second)});
+        }
+
+        ShowdownResult result = resolveShowdown<Holdem>(seats, maskOf(state.handstate.communityCards));
+
+        ToClient::Showdown showdown;
+        showdown.pot = state.pot;
+        for (size_t j = 0; j < seats.size(); j++)
+        {
+            if (result.winnings[j] > 0)
+                showdown.winners.push_back({seats[j].id, result.winnings[j]});
+        }
 
-        auto winners = determine_winner(hands, community);
         state.gameState = GameState::Showdown;
-        state.broadcast_all(serialize_server(MessageServerToClient{
-            .type = MessageTypeServerToClient::Showdown,
-            .potAmount = state.pot,
-            .idWinners = winners}));
+        state.broadcast_all(showdown);
 
-        if (winners.size() == 1)
+        for (size_t k = 0; k < result.pots.size(); k++)
         {
-            auto winner = find_client_by_id(winners[0]);
-            if (winner)
-            {
-                winner->money += state.pot;
-                cout << "Player " << winner->display_name() << " wins the pot of " << state.pot << " with a showdown!\n";
-            }
+            cout << (k == 0 ? "Main pot" : "Side pot " + to_string(k)) << " of " << result.pots[k].amount << " goes to";
+            for (int id : result.pots[k].winners)
+                cout << " " << findNameById(id) << " (ID: " << id << ")";
+            cout << "\n";
         }
-        else
+
+        for (size_t j = 0; j < seats.size(); j++)
         {
-            cout << "Players ";
-            for (size_t i = 0; i < winners.size(); i++)
+            auto winner = find_client_by_id(seats[j].id);
+            if (winner && result.winnings[j] > 0)
             {
-                auto winner = find_client_by_id(winners[i]);
-                if (winner)
-                {
-                    winner->money += state.pot / winners.size();
-                    cout << winner->display_name() << " (ID: " << winner->id << ") ";
-                }
+                winner->money += result.winnings[j];
+                cout << "Player " << winner->display_name() << " wins " << result.winnings[j] << " with a showdown!\n";
             }
-            cout << "split the pot of " << state.pot << " with a showdown!\n";
-            auto remainder_winner = find_client_by_id(state.toAct);
-            if (remainder_winner)
-                remainder_winner->money += state.pot % winners.size();
         }
 
         state.handstate.active = false;
@@ -547,7 +769,59 @@ private:
     }
 };
 
-int main()
+int main(int argc, char **argv)
 {
-    Server server;
+    // server [seed] [--checkpoint file] [--restore file]
+    //   seed: a seed printed by an earlier run, to replay its deals
+    //   --checkpoint: save the table to file whenever it waits on a player
+    //   --restore: pick up the hand saved in file (by --checkpoint) once its players have rejoined
+    uint64_t seed = randomSeed();
+    string checkpointPath, restorePath;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--checkpoint" && i + 1 < argc)
+            checkpointPath = argv[++i];
+        else if (arg == "--restore" && i + 1 < argc)
+            restorePath = argv[++i];
+        else if (!arg.empty() && isdigit((unsigned char)arg[0]))
+            seed = strtoull(arg.c_str(), nullptr, 10);
+        else
+        {
+            cerr << "Usage: server [seed] [--checkpoint file] [--restore file]\n";
+            return 1;
+        }
+    }
+
+    optional<TableSnapshot> resume;
+    if (!restorePath.empty())
+    {
+        try
+        {
+            MappedFile file(restorePath);
+            size_t count = 0;
+            const TableSnapshot *tables = viewSnapshots(file.data(), file.size(), count);
+            if (count == 0)
+                throw runtime_error(restorePath + " is empty");
+            Deck check;
+            if (!check.Restore(tables[0].deck) || (tables[0].active && !handCardsValid(tables[0])))
+                throw runtime_error(restorePath + " holds a deck or hand cards that don't add up");
+            resume = tables[0]; // One table per server for now
+            cout << "Loaded hand " << resume->handId << " from " << restorePath << ", start play once its " << int(resume->seatCount) << " players are back\n";
+        }
+        catch (exception &e)
+        {
+            cerr << "Could not restore: " << e.what() << endl;
+            return 1;
+        }
+    }
+    if (!checkpointPath.empty())
+    {
+        error_code ec;
+        auto dir = filesystem::path(checkpointPath).parent_path();
+        if (!dir.empty())
+            filesystem::create_directories(dir, ec);
+    }
+
+    Server server(seed, checkpointPath, resume);
 }
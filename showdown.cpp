@@ -0,0 +1,80 @@
+#include "showdown.hpp"
+#include <climits>
+#include <numeric>
+using namespace std;
+
+ShowdownResult resolvePots(const vector<ShowdownSeat> &seats, const vector<int> &tiers)
+{
+    ShowdownResult result;
+    result.winnings.assign(seats.size(), 0);
+
+    // Walk the contribution levels from the top down. Everyone who covered a level has been seen
+    // by the time its pot is cut, so the best live tier among them is kept up to date as seats come in.
+    vector<size_t> order(seats.size());
+    iota(order.begin(), order.end(), 0);
+    stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+                { return seats[a].committed > seats[b].committed; });
+
+    vector<size_t> best;
+    vector<vector<size_t>> potSeats;
+    int bestTier = INT_MAX;
+    int carried = 0;
+    size_t covered = 0;
+    while (covered < order.size() && seats[order[covered]].committed > 0)
+    {
+        int level = seats[order[covered]].committed;
+        bool eligibleChanged = false;
+        while (covered < order.size() && seats[order[covered]].committed == level)
+        {
+            size_t s = order[covered++];
+            if (tiers[s] < 0)
+                continue;
+            eligibleChanged = true;
+            if (tiers[s] > bestTier)
+                continue;
+            if (tiers[s] < bestTier)
+            {
+                bestTier = tiers[s];
+                best.clear();
+            }
+            best.push_back(s);
+        }
+
+        int below = covered < order.size() ? max(0, seats[order[covered]].committed) : 0;
+        int amount = (level - below) * int(covered) + carried;
+        if (best.empty())
+        {
+            carried = amount;
+            continue;
+        }
+        carried = 0;
+
+        // Levels only folded players added to are contested by the same players as the pot above
+        if (!eligibleChanged && !result.pots.empty())
+        {
+            result.pots.back().amount += amount;
+            continue;
+        }
+        SidePot pot;
+        pot.amount = amount;
+        result.pots.push_back(pot);
+        potSeats.push_back(best);
+    }
+
+    for (size_t k = 0; k < result.pots.size(); k++)
+    {
+        auto &winners = potSeats[k];
+        sort(winners.begin(), winners.end());
+        SidePot &pot = result.pots[k];
+        int share = pot.amount / int(winners.size());
+        int odd = pot.amount % int(winners.size());
+        for (size_t w = 0; w < winners.size(); w++)
+        {
+            result.winnings[winners[w]] += share + (int(w) < odd ? 1 : 0);
+            pot.winners.push_back(seats[winners[w]].id);
+        }
+    }
+
+    reverse(result.pots.begin(), result.pots.end());
+    return result;
+}
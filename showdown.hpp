@@ -0,0 +1,66 @@
+#pragma once
+#include <vector>
+#include "game_variant.hpp"
+
+// Showdown with side pots.
+//
+// Live hands are evaluated once and sorted into tiers (0 = best, equal hands share a tier). The
+// pots are then cut from the distinct amounts players put in this hand, and each one goes to the
+// best tier among the live players who covered it, so any number of side pots costs a pass over
+// the seats rather than another round of evaluation.
+
+struct ShowdownSeat
+{
+    int id = -1;
+    int committed = 0; // Chips put in the pot this hand, over every street
+    bool live = false; // Still in the hand (folded players' chips stay in the pots they reached)
+    CardMask hole = 0;
+};
+
+struct SidePot
+{
+    int amount = 0;
+    std::vector<int> winners; // Player ids
+};
+
+struct ShowdownResult
+{
+    std::vector<SidePot> pots; // Main pot first
+    std::vector<int> winnings; // Per seat, odd chips included
+};
+
+// Tier of every seat for resolvePots: 0 for the best live hand, -1 for a folded seat
+template <typename Variant>
+std::vector<int> rankTiers(const std::vector<ShowdownSeat> &seats, CardMask board)
+{
+    std::vector<HandRank> strengths(seats.size(), 0);
+    std::vector<HandRank> distinct;
+    for (size_t s = 0; s < seats.size(); s++)
+    {
+        if (!seats[s].live)
+            continue;
+        strengths[s] = Variant::Ranking::strength(evaluateHand<Variant>(seats[s].hole, board));
+        distinct.push_back(strengths[s]);
+    }
+    std::sort(distinct.begin(), distinct.end(), std::greater<HandRank>());
+    distinct.erase(std::unique(distinct.begin(), distinct.end()), distinct.end());
+
+    std::vector<int> tiers(seats.size(), -1);
+    for (size_t s = 0; s < seats.size(); s++)
+    {
+        if (seats[s].live)
+            tiers[s] = int(std::lower_bound(distinct.begin(), distinct.end(), strengths[s], std::greater<HandRank>()) - distinct.begin());
+    }
+    return tiers;
+}
+
+// Splits the chips into pots and pays each to its best tier. A pot is split evenly; the odd chips
+// go one each to its winners in seat order. Chips nobody live covered (an uncalled overbet by a
+// player who later folded) fall through to the next pot down.
+ShowdownResult resolvePots(const std::vector<ShowdownSeat> &seats, const std::vector<int> &tiers);
+
+template <typename Variant>
+ShowdownResult resolveShowdown(const std::vector<ShowdownSeat> &seats, CardMask board)
+{
+    return resolvePots(seats, rankTiers<Variant>(seats, board));
+}
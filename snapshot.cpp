@@ -0,0 +1,151 @@
+#include "snapshot.hpp"
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+using namespace std;
+
+static constexpr char SnapshotMagic[4] = {'P', 'K', 'T', 'S'};
+
+TableSnapshot emptySnapshot()
+{
+    TableSnapshot snapshot;
+    memset(&snapshot, 0, sizeof(snapshot));
+    memcpy(snapshot.magic, SnapshotMagic, sizeof(SnapshotMagic));
+    snapshot.version = SnapshotVersion;
+    snapshot.bytes = sizeof(TableSnapshot);
+    return snapshot;
+}
+
+bool writeSnapshots(const string &path, const TableSnapshot *tables, size_t count)
+{
+    ofstream out(path, ios::binary | ios::trunc);
+    if (!out.is_open())
+        return false;
+    out.write(reinterpret_cast<const char *>(tables), streamsize(count * sizeof(TableSnapshot)));
+    return bool(out);
+}
+
+const TableSnapshot *viewSnapshots(const void *data, size_t bytes, size_t &count)
+{
+    if (bytes % sizeof(TableSnapshot) != 0)
+        throw invalid_argument("snapshot: " + to_string(bytes) + " bytes is not a whole number of records");
+    if (bytes && reinterpret_cast<uintptr_t>(data) % alignof(TableSnapshot) != 0)
+        throw invalid_argument("snapshot: misaligned data");
+
+    const TableSnapshot *tables = static_cast<const TableSnapshot *>(data);
+    count = bytes / sizeof(TableSnapshot);
+    for (size_t i = 0; i < count; i++)
+    {
+        if (memcmp(tables[i].magic, SnapshotMagic, sizeof(SnapshotMagic)) != 0)
+            throw invalid_argument("snapshot: record " + to_string(i) + " is not a table snapshot");
+        if (tables[i].version != SnapshotVersion || tables[i].bytes != sizeof(TableSnapshot))
+            throw invalid_argument("snapshot: record " + to_string(i) + " has version " + to_string(tables[i].version) +
+                                   ", expected " + to_string(SnapshotVersion));
+        if (tables[i].seatCount > MaxSeats || tables[i].boardCount > 5)
+            throw invalid_argument("snapshot: record " + to_string(i) + " is corrupt");
+    }
+    return tables;
+}
+
+bool handCardsValid(const TableSnapshot &table)
+{
+    if (table.seatCount > MaxSeats || table.boardCount > 5 || table.deck.dealt > DeckSize)
+        return false;
+    CardMask dealt = 0;
+    for (int i = 0; i < table.deck.dealt; i++)
+        if (isValidCard(table.deck.cards[i]))
+            dealt |= cardBit(table.deck.cards[i]);
+
+    CardMask seen = 0;
+    auto take = [&](CardIndex card)
+    {
+        if (!isValidCard(card) || !hasCard(dealt, card) || hasCard(seen, card))
+            return false;
+        seen |= cardBit(card);
+        return true;
+    };
+    for (int i = 0; i < table.boardCount; i++)
+        if (!take(table.board[i]))
+            return false;
+    for (int j = 0; j < table.seatCount; j++)
+        if (!take(table.seats[j].hole[0]) || !take(table.seats[j].hole[1]))
+            return false;
+    return true;
+}
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const string &path)
+{
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        throw runtime_error("Could not open " + path);
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(file, &fileSize);
+    length = size_t(fileSize.QuadPart);
+    if (length == 0)
+        return;
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping)
+        view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view)
+    {
+        if (mapping)
+            CloseHandle(mapping);
+        CloseHandle(file);
+        throw runtime_error("Could not map " + path);
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    if (view)
+        UnmapViewOfFile(view);
+    if (mapping)
+        CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE)
+        CloseHandle(file);
+}
+
+#else
+
+MappedFile::MappedFile(const string &path)
+{
+    fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw runtime_error("Could not open " + path);
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+        close(fd);
+        throw runtime_error("Could not stat " + path);
+    }
+    length = size_t(info.st_size);
+    if (length == 0)
+        return;
+    void *mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED)
+    {
+        close(fd);
+        throw runtime_error("Could not map " + path);
+    }
+    view = mapped;
+}
+
+MappedFile::~MappedFile()
+{
+    if (view)
+        munmap(const_cast<void *>(view), length);
+    if (fd >= 0)
+        close(fd);
+}
+
+#endif
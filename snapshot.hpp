@@ -0,0 +1,101 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include "card_mask.hpp"
+
+// Binary checkpoints of a table: the deck (order, how far it was dealt, RNG state) and the hand in
+// progress (hole cards, board, street, pot, bets, who still has to act).
+//
+// A TableSnapshot is a fixed-layout record with no pointers, so saving is one write and loading is
+// mapping the file and pointing at it. A file is just records back to back, one per table. Fields
+// are in host byte order (little-endian on everything we build for); a layout change must bump
+// SnapshotVersion, which viewSnapshots checks along with the magic and the record size.
+
+constexpr std::uint32_t SnapshotVersion = 1;
+constexpr int MaxSeats = 10;
+
+struct DeckSnapshot
+{
+    std::uint64_t composition;
+    std::uint64_t rng[4]; // Xoshiro256 state
+    CardIndex cards[DeckSize];
+    std::uint8_t size, live, dealt; // See Deck
+    std::uint8_t reserved;
+};
+
+enum SeatFlags : std::uint8_t
+{
+    SeatInHand = 1,
+    SeatAllIn = 2,
+    SeatNeedsAction = 4
+};
+
+struct SeatSnapshot
+{
+    std::int32_t id;
+    std::int32_t committed; // Over the whole hand
+    std::int32_t betThisRound;
+    std::int32_t money;
+    CardIndex hole[2];
+    std::uint8_t flags; // SeatFlags
+    std::uint8_t reserved;
+};
+
+struct TableSnapshot
+{
+    char magic[4];       // "PKTS"
+    std::uint32_t version;
+    std::uint32_t bytes; // sizeof(TableSnapshot) when written
+    std::int32_t handId;
+    std::int32_t pot, currentBet, minRaise, lastAggressor, toAct, toCall;
+    std::uint8_t active, street, gameState, seatCount, boardCount;
+    CardIndex board[5];
+    std::uint8_t reserved[6];
+    DeckSnapshot deck;
+    SeatSnapshot seats[MaxSeats]; // In dealing order, seatCount used
+};
+
+static_assert(std::is_trivially_copyable_v<TableSnapshot> && std::is_standard_layout_v<TableSnapshot>);
+static_assert(sizeof(DeckSnapshot) == 96 && sizeof(SeatSnapshot) == 20);
+static_assert(offsetof(TableSnapshot, deck) == 56 && sizeof(TableSnapshot) == 352);
+
+// Zeroed record with the header filled in
+TableSnapshot emptySnapshot();
+
+// Writes count records to path, replacing the file. False if it can't be written.
+bool writeSnapshots(const std::string &path, const TableSnapshot *tables, std::size_t count);
+
+// The records in a block of bytes (typically a mapped file), without copying. Throws
+// std::invalid_argument if the size isn't a whole number of records or a header doesn't match.
+const TableSnapshot *viewSnapshots(const void *data, std::size_t bytes, std::size_t &count);
+
+// Whether the hole and board cards of a hand in progress can be trusted: each a real card, none
+// twice, all among the cards the snapshot's deck has already dealt. viewSnapshots only checks the
+// header and counts, so check this before putting a hand back.
+bool handCardsValid(const TableSnapshot &table);
+
+// Read-only memory map of a whole file, unmapped on destruction
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string &path); // Throws std::runtime_error if it can't be mapped
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const void *data() const { return view; }
+    std::size_t size() const { return length; }
+
+private:
+    const void *view = nullptr;
+    std::size_t length = 0;
+#ifdef _WIN32
+    void *file = nullptr;
+    void *mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+};
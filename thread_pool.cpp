@@ -0,0 +1,77 @@
+#include "thread_pool.hpp"
+using namespace std;
+
+ThreadPool::ThreadPool(unsigned threads)
+{
+    if (threads == 0)
+        threads = max(1u, thread::hardware_concurrency());
+
+    workers.reserve(threads);
+    for (unsigned i = 0; i < threads; i++)
+        workers.emplace_back([this]()
+                             { workerLoop(); });
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto &worker : workers)
+        worker.join();
+}
+
+unsigned ThreadPool::size() const
+{
+    return unsigned(workers.size());
+}
+
+void ThreadPool::post(function<void()> task)
+{
+    {
+        lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+    wake.notify_one();
+}
+
+void ThreadPool::runOnAll(const function<void(unsigned)> &task)
+{
+    std::mutex doneMutex;
+    condition_variable done;
+    unsigned remaining = size();
+
+    for (unsigned i = 0; i < size(); i++)
+    {
+        post([&, i]()
+             {
+                 task(i);
+                 lock_guard<std::mutex> lock(doneMutex);
+                 if (--remaining == 0)
+                     done.notify_one(); });
+    }
+
+    unique_lock<std::mutex> lock(doneMutex);
+    done.wait(lock, [&]()
+              { return remaining == 0; });
+}
+
+void ThreadPool::workerLoop()
+{
+    while (true)
+    {
+        function<void()> task;
+        {
+            unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this]()
+                      { return stopping || !tasks.empty(); });
+            if (stopping && tasks.empty())
+                return;
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
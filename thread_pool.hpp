@@ -0,0 +1,37 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads fed from one task queue. Shared by the equity, enumeration and
+// simulation code so a process only ever spins up one set of workers.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned threads = 0); // 0: one per hardware thread
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    unsigned size() const;
+
+    // Queues a task and returns immediately
+    void post(std::function<void()> task);
+
+    // Runs task(0) ... task(size() - 1) on the workers and waits for all of them.
+    // Must not be called from inside a pool task.
+    void runOnAll(const std::function<void(unsigned)> &task);
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    void workerLoop();
+};
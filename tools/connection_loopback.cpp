@@ -0,0 +1,263 @@
+// Loopback check for Connection (connection.hpp): a fake server on a local port and a client
+// talking to it through real sockets. Covers a burst of messages sent in one write, in text and
+// in frames and both ways, the HELLO handshake and a server that never answers it, timed reads
+// running out, and async_read. Run by ctest; exits non-zero if anything is off.
+//
+//   connection_loopback [--messages n]
+
+#include "connection.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+
+using namespace std;
+using namespace std::chrono_literals;
+
+static atomic<int> failures{0};
+
+static void check(bool ok, const string &what)
+{
+    if (!ok)
+    {
+        cerr << "FAILED: " << what << "\n";
+        failures++;
+    }
+}
+
+// Different lengths, so frames and lines straddle the read chunks at different places
+static string chatText(int i)
+{
+    return "message " + to_string(i) + " " + string(size_t(i % 97), 'x');
+}
+
+// A listening socket on a free loopback port. The fake server runs on its own thread with its own
+// io_context, the client on the test's thread with another.
+struct LoopbackServer
+{
+    boost::asio::io_context io;
+    tcp::acceptor acceptor{io, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0)};
+    thread serving;
+
+    string port() const { return to_string(acceptor.local_endpoint().port()); }
+
+    void serve(function<void(LoopbackServer &)> body)
+    {
+        serving = thread([this, body]()
+                         {
+                             try
+                             {
+                                 body(*this);
+                             }
+                             catch (exception &e)
+                             {
+                                 check(false, string("server: ") + e.what());
+                             } });
+    }
+
+    void wait()
+    {
+        if (serving.joinable())
+            serving.join();
+    }
+
+    ~LoopbackServer()
+    {
+        wait();
+    }
+};
+
+// Accepts the next connection and, when the client is expected to ask for frames, says yes the
+// way the real server does
+static void accept(LoopbackServer &server, Connection &peer, bool binary)
+{
+    // With a deadline, so a client that never comes fails the test instead of hanging it
+    boost::system::error_code ec = boost::asio::error::timed_out;
+    server.acceptor.async_accept(peer.socket(), [&](const boost::system::error_code &error)
+                                 { ec = error; });
+    server.io.restart();
+    if (server.io.run_for(5s) == 0)
+    {
+        server.acceptor.cancel();
+        server.io.restart();
+        server.io.run();
+        ec = boost::asio::error::timed_out;
+    }
+    if (ec)
+        throw boost::system::system_error(ec, "accept");
+    if (!binary)
+        return;
+    string_view line;
+    check(peer.read_for(line, 5s) && strip_line_end(line) == BinaryHello, "server: HELLO first");
+    string echo = string(BinaryHello) + "\n";
+    boost::asio::write(peer.socket(), boost::asio::buffer(echo));
+    peer.set_binary(true);
+}
+
+static bool decodeChat(bool binary, string_view message, int expected)
+{
+    MessageClientToServer msg;
+    bool ok = binary ? decode_client_binary(message, msg) : parse_client(message, msg) == ParseError::None;
+    auto chat = get_if<ToServer::Chat>(&msg);
+    return ok && chat && chat->text == chatText(expected);
+}
+
+// The server queues every message and flushes them in one write, the client takes them out one
+// at a time, then the same the other way
+static void testBurst(bool binary, int messages)
+{
+    const string mode = binary ? "binary" : "text";
+    LoopbackServer server;
+    server.serve([&](LoopbackServer &s)
+                 {
+                     Connection peer(s.io);
+                     accept(s, peer, binary);
+                     if (!binary)
+                         boost::asio::write(peer.socket(), boost::asio::buffer(string("\n\r\n"))); // Blank lines, skipped by receive
+                     for (int i = 0; i < messages; i++)
+                     {
+                         string text = chatText(i);
+                         peer.queue(ToClient::ChatFrom{i, text});
+                     }
+                     peer.flush();
+
+                     int got = 0;
+                     string_view message;
+                     while (got < messages && peer.read_for(message, 10s) && decodeChat(binary, message, got))
+                         got++;
+                     check(got == messages, mode + ": server got " + to_string(got) + " of " + to_string(messages));
+                     check(!peer.read(message) && peer.error() == boost::asio::error::eof, mode + ": server sees the client close"); });
+
+    boost::asio::io_context io;
+    Connection client(io);
+    client.connect_to("127.0.0.1", server.port(), binary);
+    check(client.uses_binary() == binary, mode + ": negotiated");
+
+    int got = 0;
+    MessageServerToClient msg;
+    while (got < messages && client.receive(msg))
+    {
+        auto chat = get_if<ToClient::ChatFrom>(&msg);
+        if (!chat || chat->playerId != got || chat->text != chatText(got))
+            break;
+        got++;
+    }
+    check(got == messages, mode + ": client got " + to_string(got) + " of " + to_string(messages));
+
+    // Nothing else is coming
+    check(!client.receive_for(msg, 50ms) && client.error() == boost::asio::error::timed_out, mode + ": timed read runs out");
+
+    for (int i = 0; i < messages; i++)
+    {
+        string text = chatText(i);
+        client.queue(ToServer::Chat{text});
+    }
+    client.flush();
+    client.close();
+    server.wait();
+}
+
+// A server that never answers HELLO: the client must give up on that connection and come back in
+// text without asking, so a late echo can't leave the two sides on different protocols
+static void testHelloTimeout()
+{
+    LoopbackServer server;
+    server.serve([&](LoopbackServer &s)
+                 {
+                     Connection first(s.io);
+                     accept(s, first, false);
+                     string_view line;
+                     check(first.read_for(line, 5s) && strip_line_end(line) == BinaryHello, "timeout: first connection asks for frames");
+
+                     Connection second(s.io);
+                     accept(s, second, false);
+                     check(!first.read_for(line, 5s) && first.error() == boost::asio::error::eof, "timeout: first connection closed");
+                     MessageClientToServer msg;
+                     check(second.receive_for(msg, 5s) && holds_alternative<ToServer::Join>(msg), "timeout: second connection starts in text"); });
+
+    boost::asio::io_context io;
+    Connection client(io);
+    client.connect_to("127.0.0.1", server.port(), true);
+    check(!client.uses_binary(), "timeout: client stays in text");
+    client.send(ToServer::Join{"late"});
+    server.wait();
+}
+
+// The server side reads with async_read until the client hangs up
+static void testAsyncRead(bool binary, int messages)
+{
+    const string mode = binary ? "async binary" : "async text";
+    LoopbackServer server;
+    server.serve([&](LoopbackServer &s)
+                 {
+                     Connection peer(s.io);
+                     accept(s, peer, binary);
+                     int got = 0;
+                     boost::system::error_code last;
+                     function<void()> next = [&]()
+                     {
+                         peer.async_read([&](const boost::system::error_code &error, string_view message)
+                                         {
+                                             if (error)
+                                             {
+                                                 last = error;
+                                                 return;
+                                             }
+                                             if (decodeChat(binary, message, got))
+                                                 got++;
+                                             next(); });
+                     };
+                     next();
+                     s.io.restart();
+                     s.io.run();
+                     check(got == messages, mode + ": got " + to_string(got) + " of " + to_string(messages));
+                     check(last == boost::asio::error::eof, mode + ": ends with the client closing"); });
+
+    boost::asio::io_context io;
+    Connection client(io);
+    client.connect_to("127.0.0.1", server.port(), binary);
+    for (int i = 0; i < messages; i++)
+    {
+        string text = chatText(i);
+        client.queue(ToServer::Chat{text});
+    }
+    client.flush();
+    client.close();
+    server.wait();
+}
+
+int main(int argc, char **argv)
+{
+    int messages = 5000;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--messages" && i + 1 < argc)
+            messages = atoi(argv[++i]);
+        else
+        {
+            cerr << "Usage: connection_loopback [--messages n]\n";
+            return 2;
+        }
+    }
+
+    try
+    {
+        testBurst(false, messages);
+        testBurst(true, messages);
+        testHelloTimeout();
+        testAsyncRead(false, messages);
+        testAsyncRead(true, messages);
+    }
+    catch (exception &e)
+    {
+        check(false, e.what());
+    }
+
+    if (failures)
+        return 1;
+    cout << "Connection loopback OK (" << messages << " messages each way)\n";
+    return 0;
+}
@@ -0,0 +1,201 @@
+// Enumerates all C(52,7) = 133,784,560 seven-card hands across every core.
+//
+//   hand_distribution [--out prefix] [--threads n] [--reference-every n]
+//
+// Writes <prefix>_categories.csv (hands per category) and <prefix>_ranks.csv (hands per distinct
+// HandRank, ordered weakest to strongest). Along the way every hand is ranked three ways
+// (IncrementalHand, evaluateMask, evaluateBatch) and every n-th hand also through the reference
+// bestof7 in visual.hpp (n = 1 checks them all, slowly). The category totals are checked against
+// the published 7-card counts. Exits 1 on any disagreement.
+
+#include "visual.hpp"
+#include "thread_pool.hpp"
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+
+using namespace std;
+
+static constexpr uint64_t TotalHands = 133784560;
+
+// Published 7-card totals; straight flushes exclude the royal ones
+static constexpr array<uint64_t, 11> KnownCategoryCounts = {
+    0, 23294460, 58627800, 31433400, 6461620, 6180020, 4047644, 3473184, 224848, 37260, 4324};
+
+struct WorkerTotals
+{
+    array<uint64_t, 11> categories{};
+    vector<uint64_t> ranks;
+    uint64_t hands = 0;
+    uint64_t mismatches = 0;
+    uint64_t referenceChecks = 0;
+};
+
+// Every distinct 5-card rank, weakest first. 7-card best hands only ever take these values.
+static vector<HandRank> distinctRanks()
+{
+    vector<HandRank> ranks;
+    ranks.reserve(2598960);
+    for (int a = 0; a < DeckSize; a++)
+        for (int b = a + 1; b < DeckSize; b++)
+            for (int c = b + 1; c < DeckSize; c++)
+                for (int d = c + 1; d < DeckSize; d++)
+                    for (int e = d + 1; e < DeckSize; e++)
+                        ranks.push_back(evaluateCards({deckCard(a), deckCard(b), deckCard(c), deckCard(d), deckCard(e)}));
+    sort(ranks.begin(), ranks.end());
+    ranks.erase(unique(ranks.begin(), ranks.end()), ranks.end());
+    return ranks;
+}
+
+int main(int argc, char **argv)
+{
+    string prefix = "hand_distribution";
+    unsigned threads = 0;
+    uint64_t referenceEvery = 1000;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--out" && i + 1 < argc)
+            prefix = argv[++i];
+        else if (arg == "--threads" && i + 1 < argc)
+            threads = unsigned(atoi(argv[++i]));
+        else if (arg == "--reference-every" && i + 1 < argc)
+            referenceEvery = strtoull(argv[++i], nullptr, 10);
+        else
+        {
+            cerr << "Usage: hand_distribution [--out prefix] [--threads n] [--reference-every n]\n";
+            return 1;
+        }
+    }
+
+    auto start = chrono::steady_clock::now();
+
+    vector<HandRank> ranks = distinctRanks();
+    vector<uint16_t> denseIndex(ranks.back() + 1, 0);
+    for (size_t i = 0; i < ranks.size(); i++)
+        denseIndex[ranks[i]] = uint16_t(i);
+
+    ThreadPool pool(threads);
+    atomic<int> nextFirstCard{0};
+    WorkerTotals total;
+    total.ranks.assign(ranks.size(), 0);
+    mutex totalMutex;
+
+    pool.runOnAll([&](unsigned)
+                  {
+        WorkerTotals mine;
+        mine.ranks.assign(ranks.size(), 0);
+
+        constexpr size_t BatchSize = 4096;
+        vector<CardMask> batchHands(BatchSize);
+        vector<HandRank> batchExpected(BatchSize), batchRanks(BatchSize);
+        size_t batched = 0;
+
+        auto flushBatch = [&]()
+        {
+            evaluateBatch(batchHands.data(), batchRanks.data(), batched);
+            for (size_t i = 0; i < batched; i++)
+                mine.mismatches += batchRanks[i] != batchExpected[i];
+            batched = 0;
+        };
+
+        auto visit = [&](const IncrementalHand &h)
+        {
+            HandRank rank = h.rank();
+            mine.categories[categoryOf(rank)]++;
+            mine.ranks[denseIndex[rank]]++;
+            mine.mismatches += evaluateMask(h.cards) != rank;
+
+            if (referenceEvery && mine.hands % referenceEvery == 0)
+            {
+                array<valRank, 7> cards;
+                CardMask rest = h.cards;
+                for (auto &card : cards)
+                {
+                    card = toValRank(lowestCard(rest));
+                    rest = popLowestCard(rest);
+                }
+                mine.mismatches += rankOfScore(bestof7(cards)) != rank;
+                mine.referenceChecks++;
+            }
+            mine.hands++;
+
+            batchHands[batched] = h.cards;
+            batchExpected[batched] = rank;
+            if (++batched == BatchSize)
+                flushBatch();
+        };
+
+        int c0;
+        while ((c0 = nextFirstCard.fetch_add(1)) <= DeckSize - 7)
+        {
+            IncrementalHand h0 = IncrementalHand{}.with(deckCard(c0));
+            for (int c1 = c0 + 1; c1 < DeckSize; c1++)
+            {
+                IncrementalHand h1 = h0.with(deckCard(c1));
+                for (int c2 = c1 + 1; c2 < DeckSize; c2++)
+                {
+                    IncrementalHand h2 = h1.with(deckCard(c2));
+                    for (int c3 = c2 + 1; c3 < DeckSize; c3++)
+                    {
+                        IncrementalHand h3 = h2.with(deckCard(c3));
+                        for (int c4 = c3 + 1; c4 < DeckSize; c4++)
+                        {
+                            IncrementalHand h4 = h3.with(deckCard(c4));
+                            for (int c5 = c4 + 1; c5 < DeckSize; c5++)
+                            {
+                                IncrementalHand h5 = h4.with(deckCard(c5));
+                                for (int c6 = c5 + 1; c6 < DeckSize; c6++)
+                                    visit(h5.with(deckCard(c6)));
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        flushBatch();
+
+        lock_guard<mutex> lock(totalMutex);
+        total.hands += mine.hands;
+        total.mismatches += mine.mismatches;
+        total.referenceChecks += mine.referenceChecks;
+        for (size_t i = 0; i < total.categories.size(); i++)
+            total.categories[i] += mine.categories[i];
+        for (size_t i = 0; i < ranks.size(); i++)
+            total.ranks[i] += mine.ranks[i]; });
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    bool ok = total.hands == TotalHands && total.mismatches == 0;
+
+    ofstream categoriesOut(prefix + "_categories.csv");
+    categoriesOut << "category,name,hands,expected\n";
+    for (int c = HighCard; c <= int(RoyalFlush); c++)
+    {
+        categoriesOut << c << "," << categoryName(HandCategory(c)) << "," << total.categories[c] << "," << KnownCategoryCounts[c] << "\n";
+        cout << categoryName(HandCategory(c)) << ": " << total.categories[c];
+        if (total.categories[c] != KnownCategoryCounts[c])
+        {
+            cout << " (expected " << KnownCategoryCounts[c] << ")";
+            ok = false;
+        }
+        cout << "\n";
+    }
+
+    ofstream ranksOut(prefix + "_ranks.csv");
+    ranksOut << "index,rank,category,hands\n";
+    size_t reachable = 0;
+    for (size_t i = 0; i < ranks.size(); i++)
+    {
+        if (total.ranks[i] == 0)
+            continue;
+        reachable++;
+        ranksOut << i << ",0x" << hex << ranks[i] << dec << "," << categoryOf(ranks[i]) << "," << total.ranks[i] << "\n";
+    }
+
+    cout << total.hands << " hands, " << reachable << " distinct ranks, " << total.referenceChecks << " checked against bestof7, "
+         << total.mismatches << " mismatches, " << pool.size() << " threads, " << seconds << "s\n";
+    cout << (ok ? "OK" : "FAILED") << "\n";
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,327 @@
+// Microbenchmarks for the hot paths: hand evaluation, dealing and message (de)serialization.
+//
+//   poker_bench [--filter text] [--time ms] [--json file]
+//
+// Every benchmark reports ns/op, heap allocations/op and p50/p90/p99 latency. Latencies are
+// taken per batch of ops sized to run for at least 10 microseconds, so very cheap ops are
+// averaged over their batch. The evaluators also report hands/s (an evaluateBatch op ranks a
+// whole array), the number to compare them by. --json writes the same numbers for comparing builds.
+
+#include "visual.hpp"
+#include "deck.h"
+#include "binary_protocol.hpp"
+#include "bulk_deals.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+
+using namespace std;
+
+static atomic<uint64_t> allocationCount{0};
+
+// Counting replacements for the global allocator. GCC can't see that these pair malloc with free.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void *operator new(size_t size)
+{
+    allocationCount.fetch_add(1, memory_order_relaxed);
+    if (void *p = malloc(size ? size : 1))
+        return p;
+    throw bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+static volatile uint64_t sink; // Keeps results alive so the optimizer can't drop the work
+
+struct BenchResult
+{
+    string name;
+    uint64_t ops = 0;
+    double nsPerOp = 0;
+    double allocsPerOp = 0;
+    double p50 = 0, p90 = 0, p99 = 0;
+    string unit;           // What an op processes, e.g. "hands"; empty for benches without a rate
+    double perSecond = 0; // Of unit
+};
+
+using Clock = chrono::steady_clock;
+
+template <typename Op>
+static BenchResult runBench(const string &name, chrono::milliseconds budget, Op &&op)
+{
+    // Size batches so one takes at least 10us, well above the clock's resolution and overhead
+    uint64_t batch = 1;
+    while (true)
+    {
+        auto start = Clock::now();
+        for (uint64_t i = 0; i < batch; i++)
+            op(i);
+        if (Clock::now() - start >= chrono::microseconds(10) || batch >= (1u << 20))
+            break;
+        batch *= 2;
+    }
+
+    vector<double> perOp;
+    uint64_t ops = 0;
+    double measured = 0;
+    uint64_t allocsBefore = allocationCount.load();
+    auto start = Clock::now();
+    auto end = start + budget;
+    Clock::time_point now = start;
+    while (now < end)
+    {
+        auto batchStart = Clock::now();
+        for (uint64_t i = 0; i < batch; i++)
+            op(ops + i);
+        now = Clock::now();
+        double batchTime = chrono::duration<double, nano>(now - batchStart).count();
+        measured += batchTime;
+        perOp.push_back(batchTime / batch);
+        ops += batch;
+    }
+    uint64_t allocs = allocationCount.load() - allocsBefore;
+
+    sort(perOp.begin(), perOp.end());
+    auto percentile = [&](double p)
+    { return perOp[min(perOp.size() - 1, size_t(p * perOp.size()))]; };
+
+    BenchResult result;
+    result.name = name;
+    result.ops = ops;
+    result.nsPerOp = measured / ops;
+    result.allocsPerOp = double(allocs) / ops;
+    result.p50 = percentile(0.50);
+    result.p90 = percentile(0.90);
+    result.p99 = percentile(0.99);
+    return result;
+}
+
+static vector<CardMask> randomHands(mt19937_64 &rng, size_t count, int cards)
+{
+    vector<CardMask> hands(count);
+    for (auto &hand : hands)
+    {
+        while (cardCount(hand) < cards)
+            hand |= cardBit(deckCard(int(rng() % DeckSize)));
+    }
+    return hands;
+}
+
+template <size_t N>
+static array<valRank, N> toValRanks(CardMask hand)
+{
+    array<valRank, N> cards;
+    for (size_t i = 0; i < N; i++, hand = popLowestCard(hand))
+        cards[i] = toValRank(lowestCard(hand));
+    return cards;
+}
+
+static void writeJson(const string &path, const vector<BenchResult> &results)
+{
+    ofstream out(path);
+    if (!out.is_open())
+    {
+        cerr << "Could not open " << path << " for writing\n";
+        return;
+    }
+    out << "[\n";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const auto &r = results[i];
+        out << "  {\"name\": \"" << r.name << "\", \"ops\": " << r.ops << ", \"ns_per_op\": " << r.nsPerOp
+            << ", \"allocs_per_op\": " << r.allocsPerOp << ", \"p50_ns\": " << r.p50 << ", \"p90_ns\": " << r.p90
+            << ", \"p99_ns\": " << r.p99;
+        if (!r.unit.empty())
+            out << ", \"" << r.unit << "_per_s\": " << r.perSecond;
+        out << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "]\n";
+}
+
+int main(int argc, char **argv)
+{
+    string filter;
+    string jsonPath;
+    chrono::milliseconds budget{300};
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc)
+            filter = argv[++i];
+        else if (arg == "--json" && i + 1 < argc)
+            jsonPath = argv[++i];
+        else if (arg == "--time" && i + 1 < argc)
+            budget = chrono::milliseconds(atoi(argv[++i]));
+        else
+        {
+            cerr << "Usage: poker_bench [--filter text] [--time ms] [--json file]\n";
+            return 1;
+        }
+    }
+
+    constexpr size_t InputCount = 4096; // Power of two, indexed with & (InputCount - 1)
+    mt19937_64 rng(12345);
+    vector<CardMask> hands5 = randomHands(rng, InputCount, 5);
+    vector<CardMask> hands7 = randomHands(rng, InputCount, 7);
+    vector<array<valRank, 5>> valRank5;
+    vector<array<valRank, 7>> valRank7;
+    for (size_t i = 0; i < InputCount; i++)
+    {
+        valRank5.push_back(toValRanks<5>(hands5[i]));
+        valRank7.push_back(toValRanks<7>(hands7[i]));
+    }
+    vector<HandRank> batchRanks(InputCount);
+
+    // Six-handed showdowns drawn from one shuffled deck each
+    vector<pair<vector<hand>, vector<CardIndex>>> showdowns;
+    for (size_t i = 0; i < 256; i++)
+    {
+        vector<CardIndex> cards;
+        for (int c = 0; c < DeckSize; c++)
+            cards.push_back(deckCard(c));
+        shuffle(cards.begin(), cards.end(), rng);
+        vector<hand> players;
+        for (int p = 0; p < 6; p++)
+            players.push_back({cards[2 * p], cards[2 * p + 1]});
+        showdowns.push_back({players, vector<CardIndex>(cards.begin() + 12, cards.begin() + 17)});
+    }
+
+    Deck deck;
+
+    const MessageServerToClient bettingUpdate = ToClient::BettingUpdate{.toAct = 3, .toCall = 100, .currentBet = 200, .minRaise = 100, .pot = 1250};
+    vector<string> names;
+    ToClient::Roster roster;
+    for (int id = 0; id < 6; id++)
+        names.push_back("player" + to_string(id));
+    for (int id = 0; id < 6; id++)
+        roster.players.push_back({id, 1000 + id, names[id]});
+    const MessageServerToClient roster6 = roster;
+    const string actionLine = "ACTION 3 200";
+    const string chatLine = "CHAT good game everyone";
+
+    vector<BenchResult> results;
+    // unit and perOp: what one op processes and how many, for a rate alongside ns/op
+    auto bench = [&](const string &name, auto &&op, const string &unit = "", uint64_t perOp = 1)
+    {
+        if (!filter.empty() && name.find(filter) == string::npos)
+            return;
+        results.push_back(runBench(name, budget, op));
+        auto &r = results.back();
+        printf("%-34s %12.1f ns/op %8.2f allocs/op   p50 %10.1f  p90 %10.1f  p99 %10.1f ns",
+               r.name.c_str(), r.nsPerOp, r.allocsPerOp, r.p50, r.p90, r.p99);
+        if (!unit.empty())
+        {
+            r.unit = unit;
+            r.perSecond = perOp * 1e9 / r.nsPerOp;
+            printf("   %10.2fM %s/s", r.perSecond / 1e6, unit.c_str());
+        }
+        printf("\n");
+    };
+
+    bench("eval/score5", [&](uint64_t i)
+          { sink = sink + score5(valRank5[i & (InputCount - 1)])[0]; }, "hands");
+    bench("eval/bestof7", [&](uint64_t i)
+          { sink = sink + bestof7(valRank7[i & (InputCount - 1)])[0]; }, "hands");
+    bench("eval/evaluate7", [&](uint64_t i)
+          { sink = sink + evaluate7(valRank7[i & (InputCount - 1)]); }, "hands");
+    bench("eval/evaluateMask", [&](uint64_t i)
+          { sink = sink + evaluateMask(hands7[i & (InputCount - 1)]); }, "hands");
+    vector<IncrementalHand> turnHands;
+    for (CardMask hand : hands7)
+        turnHands.push_back(incrementalHandOf(popLowestCard(hand)));
+    bench("eval/incremental_add_river", [&](uint64_t i)
+          {
+              size_t n = i & (InputCount - 1);
+              sink = sink + turnHands[n].with(lowestCard(hands7[n])).rank(); }, "hands");
+    bench("eval/evaluateBatch_x4096", [&](uint64_t)
+          { evaluateBatch(hands7.data(), batchRanks.data(), InputCount); sink = sink + batchRanks[0]; }, "hands", InputCount);
+
+    // determine_winner logs the winners; mute cout so the bench measures the evaluation
+    streambuf *coutBuf = cout.rdbuf(nullptr);
+    bench("showdown/determine_winner_6max", [&](uint64_t i)
+          {
+              auto &s = showdowns[i & 255];
+              sink = sink + determine_winner(s.first, s.second).size(); });
+    cout.clear();
+    cout.rdbuf(coutBuf);
+
+    Xoshiro256 xoshiro(12345);
+    bench("rng/xoshiro_bounded52", [&](uint64_t)
+          { sink = sink + xoshiro.bounded(52); });
+    bench("deck/Reset_deal_6max_hand", [&](uint64_t)
+          {
+              deck.Reset();
+              for (int c = 0; c < 17; c++)
+                  sink = sink + deck.DrawCard(); });
+    bench("deck/DrawCard", [&](uint64_t)
+          { sink = sink + deck.DrawCard(); });
+    ThreadPool pool;
+    vector<CardIndex> deals(InputCount * 17);
+    bench("deck/generateDeals_17x4096", [&](uint64_t i)
+          { generateDeals(pool, 12345, deals.data(), InputCount, 17, FullDeckMask, i * InputCount); sink = sink + deals[0]; });
+
+    // Into a reused buffer, the way the server sends: no allocation once it has grown
+    string textOut;
+    MessageClientToServer action = ToServer::Action{PlayerActionType::Raise, 200};
+    bench("net/serialize_server_BettingUpdate", [&](uint64_t)
+          {
+              textOut.clear();
+              serialize_server(bettingUpdate, textOut);
+              sink = sink + textOut.size(); });
+    bench("net/serialize_server_Roster6", [&](uint64_t)
+          {
+              textOut.clear();
+              serialize_server(roster6, textOut);
+              sink = sink + textOut.size(); });
+    bench("net/serialize_client_Action", [&](uint64_t)
+          {
+              textOut.clear();
+              serialize_client(action, textOut);
+              sink = sink + textOut.size(); });
+    // Parsed into a reused message, as Client::handle_line does
+    MessageClientToServer parsed;
+    MessageServerToClient parsedUpdate;
+    const string bettingUpdateLine = serialize_server(bettingUpdate);
+    bench("net/parse_client_Action", [&](uint64_t)
+          {
+              parse_client(actionLine, parsed);
+              sink = sink + get<ToServer::Action>(parsed).amount; });
+    bench("net/parse_client_Chat", [&](uint64_t)
+          {
+              parse_client(chatLine, parsed);
+              sink = sink + get<ToServer::Chat>(parsed).text.size(); });
+    bench("net/parse_server_BettingUpdate", [&](uint64_t)
+          {
+              parse_server(bettingUpdateLine, parsedUpdate);
+              sink = sink + get<ToClient::BettingUpdate>(parsedUpdate).pot; });
+
+    const string actionResultFrame = encode_server_binary(ToClient::ActionResult{.playerId = 3, .action = PlayerActionType::Raise, .amount = 200});
+    string frameOut;
+    MessageServerToClient decoded;
+    bench("net/encode_binary_BettingUpdate", [&](uint64_t)
+          {
+              frameOut.clear();
+              encode_server_binary(bettingUpdate, frameOut);
+              sink = sink + frameOut.size(); });
+    bench("net/decode_binary_ActionResult", [&](uint64_t)
+          {
+              decode_server_binary(string_view(actionResultFrame).substr(FrameHeaderSize), decoded);
+              sink = sink + get<ToClient::ActionResult>(decoded).amount; });
+
+    if (!jsonPath.empty())
+        writeJson(jsonPath, results);
+}
@@ -0,0 +1,446 @@
+// Fuzz target for everything that decodes bytes off the network: parse_client, parse_server,
+// deserialize_client, decode_client_binary, decode_server_binary and PokerClient's
+// handle_line/handle_frame.
+//
+//   protocol_fuzz [--runs n] [--seed s] [inputs...]    replay files, or mutate the built-in corpus
+//   protocol_fuzz --corpus dir                         write the built-in corpus out as fuzzer seeds
+//   protocol_fuzz --throughput [--time ms]             messages/second per decoder
+//
+// Built with POKER_LIBFUZZER defined and -fsanitize=fuzzer (cmake -DPOKER_FUZZ=ON, clang) this is an
+// ordinary libFuzzer target and libFuzzer supplies main. Either way an input is read both as lines
+// (every line through the text decoders) and as length-prefixed frames (every body through the
+// binary ones), and the client gets the whole sequence, so roster deltas and hands in progress
+// get exercised too. Every message that decodes must come back unchanged through its encoder,
+// anything else aborts; build with -fsanitize=address,undefined to catch the rest.
+//
+// --throughput runs each decoder over the valid corpus and over a mutated copy of it. The hot
+// path should stay hot, check here before and after making a decoder stricter.
+
+#include "binary_protocol.hpp"
+#include "client_in_client.hpp"
+#include "rng.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+static volatile uint64_t sink; // Keeps results alive so the optimizer can't drop the work
+
+// PokerClient keeps its handlers private; this is the one outside caller
+struct ClientFuzzer
+{
+    unique_ptr<PokerClient> client = make_unique<PokerClient>();
+
+    // Handlers that resync the roster write to the socket, which isn't connected here
+    void line(string_view line)
+    {
+        try
+        {
+            client->handle_line(line);
+        }
+        catch (const boost::system::system_error &)
+        {
+        }
+    }
+
+    void frame(string_view body)
+    {
+        try
+        {
+            client->handle_frame(body);
+        }
+        catch (const boost::system::system_error &)
+        {
+        }
+    }
+};
+
+[[noreturn]] static void roundTripFailed(const char *codec, string_view input)
+{
+    fprintf(stderr, "%s: a decoded message didn't survive re-encoding. Input (%zu bytes):", codec, input.size());
+    for (unsigned char c : input)
+        fprintf(stderr, " %02x", c);
+    fprintf(stderr, "\n");
+    abort();
+}
+
+template <typename Variant>
+static bool sameMessage(const Variant &a, const Variant &b)
+{
+    return a.index() == b.index() && visit([&](const auto &m)
+                                           { return SchemaCheck::sameFields(m, get<decay_t<decltype(m)>>(b)); },
+                                           a);
+}
+
+template <typename Variant>
+static void checkText(string_view line)
+{
+    Variant msg;
+    if (read_text(line, msg) != ParseError::None)
+        return;
+    string again;
+    write_text(msg, again);
+    Variant back;
+    if (read_text(again, back) != ParseError::None || !sameMessage(msg, back))
+        roundTripFailed("text", line);
+}
+
+template <typename Variant>
+static void checkBinary(string_view body)
+{
+    Variant msg;
+    if (!decode_binary(body, msg))
+        return;
+    string again;
+    encode_binary(msg, again);
+    Variant back;
+    if (frame_body_length(again.data()) != again.size() - FrameHeaderSize ||
+        !decode_binary(string_view(again).substr(FrameHeaderSize), back) || !sameMessage(msg, back))
+        roundTripFailed("binary", body);
+}
+
+// Calls f with every line of data, newline included
+template <typename F>
+static void forEachLine(string_view data, F &&f)
+{
+    while (!data.empty())
+    {
+        size_t end = data.find('\n');
+        size_t length = end == string_view::npos ? data.size() : end + 1;
+        f(data.substr(0, length));
+        data.remove_prefix(length);
+    }
+}
+
+// Calls f with the body of every complete frame at the front of data
+template <typename F>
+static void forEachFrame(string_view data, F &&f)
+{
+    while (data.size() >= FrameHeaderSize)
+    {
+        size_t body = frame_body_length(data.data());
+        if (data.size() - FrameHeaderSize < body)
+            break;
+        f(data.substr(FrameHeaderSize, body));
+        data.remove_prefix(FrameHeaderSize + body);
+    }
+}
+
+static void fuzzOne(string_view data)
+{
+    ClientFuzzer client; // Fresh each time, so a crash reproduces from its input alone
+    forEachLine(data, [&](string_view line)
+                {
+                    checkText<MessageClientToServer>(line);
+                    checkText<MessageServerToClient>(line);
+                    sink = sink + deserialize_client(line).index();
+                    client.line(line); });
+    forEachFrame(data, [&](string_view body)
+                 {
+                     checkBinary<MessageClientToServer>(body);
+                     checkBinary<MessageServerToClient>(body);
+                     client.frame(body); });
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    static bool quiet = [] // The client narrates every message
+    {
+        cout.rdbuf(nullptr);
+        return true;
+    }();
+    (void)quiet;
+    fuzzOne(string_view(reinterpret_cast<const char *>(data), size));
+    return 0;
+}
+
+#ifndef POKER_LIBFUZZER // The standalone driver; libFuzzer brings its own
+
+// Every message of a variant with a few different sample values each, see SchemaCheck
+template <typename Variant, typename Encode>
+static vector<string> sampleMessages(Encode encode)
+{
+    vector<string> out;
+    for (int round = 0; round < 4; round++)
+    {
+        [&]<size_t... I>(index_sequence<I...>)
+        {
+            ([&]
+             {
+                 variant_alternative_t<I, Variant> msg{};
+                 int seed = round * 31 + int(I);
+                 SchemaCheck::fillSample(msg, seed);
+                 string encoded;
+                 encode(Variant(msg), encoded);
+                 out.push_back(encoded); }(),
+             ...);
+        }(make_index_sequence<variant_size_v<Variant>>());
+    }
+    return out;
+}
+
+struct Corpus
+{
+    vector<string> clientLines, serverLines, clientFrames, serverFrames; // One message each, frames with their header
+
+    Corpus()
+    {
+        clientLines = sampleMessages<MessageClientToServer>([](const MessageClientToServer &m, string &out)
+                                                            { serialize_client(m, out); });
+        serverLines = sampleMessages<MessageServerToClient>([](const MessageServerToClient &m, string &out)
+                                                            { serialize_server(m, out); });
+        clientFrames = sampleMessages<MessageClientToServer>([](const MessageClientToServer &m, string &out)
+                                                             { encode_client_binary(m, out); });
+        serverFrames = sampleMessages<MessageServerToClient>([](const MessageServerToClient &m, string &out)
+                                                             { encode_server_binary(m, out); });
+    }
+
+    // Seeds: each message on its own, plus whole sessions in each format
+    vector<string> seeds() const
+    {
+        vector<string> out;
+        for (const auto *messages : {&clientLines, &serverLines, &clientFrames, &serverFrames})
+        {
+            string session;
+            for (const string &m : *messages)
+            {
+                out.push_back(m);
+                session += m;
+            }
+            out.push_back(session);
+        }
+        return out;
+    }
+};
+
+static string mutate(string input, Xoshiro256 &rng, const vector<string> &seeds)
+{
+    int edits = 1 + int(rng() % 4);
+    for (int i = 0; i < edits; i++)
+    {
+        size_t at = input.empty() ? 0 : size_t(rng() % input.size());
+        switch (rng() % 6)
+        {
+        case 0: // Flip a bit
+            if (!input.empty())
+                input[at] = char(input[at] ^ (1 << (rng() % 8)));
+            break;
+        case 1: // Random byte
+            if (!input.empty())
+                input[at] = char(rng());
+            break;
+        case 2: // Interesting byte: separators, signs, digits, length bytes
+        {
+            static const char interesting[] = {' ', '\n', '\r', '\t', '-', '0', '9', '\0', '\x7f', '\xff'};
+            input.insert(input.begin() + at, interesting[rng() % sizeof(interesting)]);
+            break;
+        }
+        case 3: // Delete a run
+            if (!input.empty())
+                input.erase(at, size_t(1 + rng() % 8));
+            break;
+        case 4: // Duplicate a run
+            if (!input.empty())
+                input.insert(at, input.substr(at, size_t(1 + rng() % 16)));
+            break;
+        default: // Splice in part of another seed
+        {
+            const string &other = seeds[rng() % seeds.size()];
+            size_t from = other.empty() ? 0 : size_t(rng() % other.size());
+            input.insert(at, other.substr(from, size_t(rng() % 32)));
+            break;
+        }
+        }
+    }
+    return input;
+}
+
+static vector<string> mutated(const vector<string> &messages, uint64_t seed)
+{
+    Xoshiro256 rng(seed);
+    vector<string> out;
+    for (int copy = 0; copy < 8; copy++)
+    {
+        for (const string &m : messages)
+            out.push_back(mutate(m, rng, messages));
+    }
+    return out;
+}
+
+using Clock = chrono::steady_clock;
+
+// Runs decode over inputs, round and round, for budget; messages per second
+template <typename Decode>
+static double messagesPerSecond(const vector<string> &inputs, chrono::milliseconds budget, Decode &&decode)
+{
+    uint64_t messages = 0;
+    auto start = Clock::now();
+    auto end = start + budget;
+    Clock::time_point now = start;
+    while (now < end)
+    {
+        for (const string &input : inputs)
+            decode(string_view(input));
+        messages += inputs.size();
+        now = Clock::now();
+    }
+    return messages / chrono::duration<double>(now - start).count();
+}
+
+static vector<string> stripHeaders(const vector<string> &frames)
+{
+    vector<string> bodies;
+    for (const string &frame : frames)
+        bodies.push_back(frame.size() < FrameHeaderSize ? string() : frame.substr(FrameHeaderSize));
+    return bodies;
+}
+
+static void throughput(chrono::milliseconds budget)
+{
+    Corpus corpus;
+    vector<string> clientBodies = stripHeaders(corpus.clientFrames), serverBodies = stripHeaders(corpus.serverFrames);
+    ClientFuzzer client;
+    MessageClientToServer toServer;
+    MessageServerToClient toClient;
+
+    struct Decoder
+    {
+        const char *name;
+        const vector<string> *inputs;
+        function<void(string_view)> decode;
+    };
+    const Decoder decoders[] = {
+        {"parse_client", &corpus.clientLines, [&](string_view s)
+         { sink = sink + int(parse_client(s, toServer)); }},
+        {"deserialize_client", &corpus.clientLines, [&](string_view s)
+         { sink = sink + deserialize_client(s).index(); }},
+        {"parse_server", &corpus.serverLines, [&](string_view s)
+         { sink = sink + int(parse_server(s, toClient)); }},
+        {"decode_client_binary", &clientBodies, [&](string_view s)
+         { sink = sink + decode_client_binary(s, toServer); }},
+        {"decode_server_binary", &serverBodies, [&](string_view s)
+         { sink = sink + decode_server_binary(s, toClient); }},
+        {"PokerClient::handle_line", &corpus.serverLines, [&](string_view s)
+         { client.line(s); }},
+        {"PokerClient::handle_frame", &serverBodies, [&](string_view s)
+         { client.frame(s); }},
+    };
+
+    printf("%-28s %14s %14s\n", "decoder", "valid msg/s", "mutated msg/s");
+    for (const Decoder &d : decoders)
+    {
+        vector<string> garbage = mutated(*d.inputs, 12345);
+        double valid = messagesPerSecond(*d.inputs, budget, d.decode);
+        double bad = messagesPerSecond(garbage, budget, d.decode);
+        printf("%-28s %13.2fM %13.2fM\n", d.name, valid / 1e6, bad / 1e6);
+    }
+}
+
+static bool readFile(const filesystem::path &path, string &out)
+{
+    ifstream in(path, ios::binary);
+    if (!in.is_open())
+        return false;
+    out.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t runs = 100000;
+    uint64_t seed = randomSeed();
+    int timeMs = 300;
+    bool measure = false;
+    string corpusDir;
+    vector<string> inputs;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--runs" && i + 1 < argc)
+            runs = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--seed" && i + 1 < argc)
+            seed = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--throughput")
+            measure = true;
+        else if (arg == "--time" && i + 1 < argc)
+            timeMs = atoi(argv[++i]);
+        else if (arg == "--corpus" && i + 1 < argc)
+            corpusDir = argv[++i];
+        else if (!arg.empty() && arg[0] != '-')
+            inputs.push_back(arg);
+        else
+        {
+            cerr << "Usage: protocol_fuzz [--runs n] [--seed s] [inputs...] | --corpus dir | --throughput [--time ms]\n";
+            return 1;
+        }
+    }
+    cout.rdbuf(nullptr); // The client narrates every message; results go through printf
+
+    if (measure)
+    {
+        throughput(chrono::milliseconds(timeMs));
+        return 0;
+    }
+
+    Corpus corpus;
+    vector<string> seeds = corpus.seeds();
+    if (!corpusDir.empty())
+    {
+        filesystem::create_directories(corpusDir);
+        for (size_t i = 0; i < seeds.size(); i++)
+        {
+            ofstream out(filesystem::path(corpusDir) / ("seed" + to_string(i)), ios::binary);
+            out.write(seeds[i].data(), streamsize(seeds[i].size()));
+        }
+        printf("%zu seeds -> %s\n", seeds.size(), corpusDir.c_str());
+        return 0;
+    }
+
+    if (!inputs.empty())
+    {
+        // Replay: files, or every file in a directory
+        size_t count = 0;
+        for (const string &input : inputs)
+        {
+            vector<filesystem::path> files;
+            if (filesystem::is_directory(input))
+            {
+                for (const auto &entry : filesystem::directory_iterator(input))
+                    files.push_back(entry.path());
+            }
+            else
+                files.push_back(input);
+            for (const auto &file : files)
+            {
+                string data;
+                if (!readFile(file, data))
+                {
+                    cerr << "Could not read " << file << "\n";
+                    return 1;
+                }
+                fuzzOne(data);
+                count++;
+            }
+        }
+        printf("%zu inputs, no failures\n", count);
+        return 0;
+    }
+
+    Xoshiro256 rng(seed);
+    auto start = Clock::now();
+    for (const string &s : seeds)
+        fuzzOne(s);
+    for (uint64_t run = 0; run < runs; run++)
+        fuzzOne(mutate(seeds[rng() % seeds.size()], rng, seeds));
+    double seconds = chrono::duration<double>(Clock::now() - start).count();
+    printf("%llu mutated inputs, seed %llu, no failures (%.1fs, %.0f inputs/s)\n", (unsigned long long)runs, (unsigned long long)seed,
+           seconds, runs / seconds);
+}
+#endif
@@ -0,0 +1,132 @@
+// Side pot check for showdown.hpp: hand-worked tables run through resolvePots (tiers given
+// directly) and resolveShowdown (tiers from real cards), comparing every pot, its winners and
+// what each seat takes home. Every case must also pay out exactly the chips that went in. Run by
+// ctest; exits non-zero if anything is off.
+
+#include "showdown.hpp"
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static int failures = 0;
+
+static void check(bool ok, const string &what)
+{
+    if (!ok)
+    {
+        cerr << "FAILED: " << what << "\n";
+        failures++;
+    }
+}
+
+static string describe(const ShowdownResult &result)
+{
+    string text;
+    for (const SidePot &pot : result.pots)
+    {
+        text += " [" + to_string(pot.amount) + ":";
+        for (int id : pot.winners)
+            text += " " + to_string(id);
+        text += "]";
+    }
+    text += " paid";
+    for (int chips : result.winnings)
+        text += " " + to_string(chips);
+    return text;
+}
+
+// Seats are given as {committed, live}, ids are the seat indices
+static void checkPots(const string &name, const vector<pair<int, bool>> &table, const vector<int> &tiers,
+                      const vector<SidePot> &pots, const vector<int> &winnings)
+{
+    vector<ShowdownSeat> seats;
+    for (size_t s = 0; s < table.size(); s++)
+        seats.push_back({int(s), table[s].first, table[s].second, 0});
+    ShowdownResult result = resolvePots(seats, tiers);
+
+    bool same = result.pots.size() == pots.size() && result.winnings == winnings;
+    for (size_t k = 0; same && k < pots.size(); k++)
+        same = result.pots[k].amount == pots[k].amount && result.pots[k].winners == pots[k].winners;
+    check(same, name + ": got" + describe(result));
+
+    int in = 0;
+    for (auto &seat : table)
+        in += seat.first;
+    check(accumulate(result.winnings.begin(), result.winnings.end(), 0) == in, name + ": chips in and out differ");
+}
+
+static CardMask cards(initializer_list<CardIndex> list)
+{
+    CardMask mask = 0;
+    for (CardIndex card : list)
+        mask |= cardBit(card);
+    return mask;
+}
+
+int main()
+{
+    // All in for 100, 300 and 500, best hand shortest: each pot goes to the best hand that covered it,
+    // and the 200 nobody called comes back
+    checkPots("three stacks", {{100, true}, {300, true}, {500, true}}, {0, 1, 2},
+              {{300, {0}}, {400, {1}}, {200, {2}}}, {300, 400, 200});
+
+    // Same stacks, biggest stack best: it takes everything
+    checkPots("big stack wins", {{100, true}, {300, true}, {500, true}}, {2, 1, 0},
+              {{300, {2}}, {400, {2}}, {200, {2}}}, {0, 0, 900});
+
+    // Four stacks, the middle two tie: they split the pots both covered, the short one takes the main
+    checkPots("four stacks with a tie", {{50, true}, {200, true}, {200, true}, {400, true}}, {0, 1, 1, 2},
+              {{200, {0}}, {450, {1, 2}}, {200, {3}}}, {200, 225, 225, 200});
+
+    // 303 split two ways: the odd chip goes to the first winner in seat order
+    checkPots("odd chip", {{101, true}, {101, true}, {101, true}}, {1, 0, 0},
+              {{303, {1, 2}}}, {0, 152, 151});
+
+    // 100 split three ways: the first winner by seat gets the extra chip
+    checkPots("three-way odd chips", {{25, true}, {25, true}, {25, true}, {25, false}}, {0, 0, 0, -1},
+              {{100, {0, 1, 2}}}, {34, 33, 33, 0});
+
+    // An odd side pot: 2 x 22 from the two callers plus 3 x 29 from the level the folded seat reached
+    // makes 131 for seats 1 and 2, while the main pot of 4 x 31 goes to seat 0
+    checkPots("odd chips in a side pot", {{31, true}, {82, true}, {82, true}, {60, false}}, {0, 1, 1, -1},
+              {{124, {0}}, {131, {1, 2}}}, {124, 66, 65, 0});
+
+    // A folded player's chips stay in the pots they reached: of seat 2's 200, 100 is in the main
+    // pot and 100 in the side pot
+    checkPots("folded contributor", {{100, true}, {300, true}, {200, false}}, {0, 1, -1},
+              {{300, {0}}, {300, {1}}}, {300, 300, 0});
+
+    // A folded overbet nobody called falls through to the pot below
+    checkPots("folded overbet", {{100, true}, {100, true}, {500, false}}, {1, 0, -1},
+              {{700, {1}}}, {0, 700, 0});
+
+    // Everyone else folded: the one live player takes it all, however little they put in
+    checkPots("single live player", {{50, true}, {100, false}, {200, false}}, {0, -1, -1},
+              {{350, {0}}}, {350, 0, 0});
+
+    // Nobody put anything in
+    checkPots("empty pot", {{0, true}, {0, true}}, {0, 0}, {}, {0, 0});
+
+    // Real cards: seat 0 has the nut flush all in for 100, seat 1 two pair for 250, seat 2 one
+    // pair for 250 and seat 3 folded quads after 60
+    CardMask board = cards({makeCard(14, 0), makeCard(9, 0), makeCard(5, 0), makeCard(9, 1), makeCard(2, 2)});
+    vector<ShowdownSeat> seats = {
+        {10, 100, true, cards({makeCard(13, 0), makeCard(3, 0)})},
+        {11, 250, true, cards({makeCard(14, 1), makeCard(5, 3)})},
+        {12, 250, true, cards({makeCard(13, 2), makeCard(12, 3)})},
+        {13, 60, false, cards({makeCard(9, 2), makeCard(9, 3)})},
+    };
+    check(rankTiers<Holdem>(seats, board) == vector<int>{0, 1, 2, -1}, "real cards: tiers");
+    ShowdownResult result = resolveShowdown<Holdem>(seats, board);
+    check(result.pots.size() == 2 && result.pots[0].amount == 360 && result.pots[0].winners == vector<int>{10} &&
+              result.pots[1].amount == 300 && result.pots[1].winners == vector<int>{11},
+          "real cards: got" + describe(result));
+
+    if (failures)
+        return 1;
+    cout << "Showdown pots OK\n";
+    return 0;
+}
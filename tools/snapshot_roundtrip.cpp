@@ -0,0 +1,169 @@
+// Round trip check for table checkpoints (snapshot.hpp) and saved decks: writes tables taken from
+// decks part way through hands, maps the file back and compares it byte for byte, then checks that
+// a deck restored from it deals the same cards as the one that was saved. Also checks that broken
+// files, and hands whose cards don't match their deck, are refused. Run by ctest; exits non-zero if anything doesn't match.
+//
+//   snapshot_roundtrip [--dir d]   (scratch files go in d, the system temp directory by default)
+
+#include "deck.h"
+#include "game_variant.hpp"
+#include "snapshot.hpp"
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static int failures = 0;
+
+static void check(bool ok, const string &what)
+{
+    if (!ok)
+    {
+        cerr << "FAILED: " << what << "\n";
+        failures++;
+    }
+}
+
+// A table some way into a hand, dealt from deck
+static TableSnapshot dealTable(Deck &deck, int handId, int seats, int boardCount)
+{
+    TableSnapshot snap = emptySnapshot();
+    snap.handId = handId;
+    snap.active = 1;
+    snap.street = uint8_t(boardCount ? boardCount - 2 : 0);
+    snap.seatCount = uint8_t(seats);
+    for (int j = 0; j < seats; j++)
+    {
+        SeatSnapshot &seat = snap.seats[j];
+        seat.id = j;
+        seat.hole[0] = deck.DrawCard();
+        seat.hole[1] = deck.DrawCard();
+        seat.committed = 50 * (j + 1);
+        seat.betThisRound = 25 * j;
+        seat.money = 1000 - seat.committed;
+        seat.flags = SeatInHand | (j % 3 == 0 ? SeatNeedsAction : 0) | (j == seats - 1 ? SeatAllIn : 0);
+        snap.pot += seat.committed;
+    }
+    snap.boardCount = uint8_t(boardCount);
+    for (int i = 0; i < boardCount; i++)
+        snap.board[i] = deck.DrawCard();
+    snap.currentBet = 50;
+    snap.minRaise = 50;
+    snap.toAct = 0;
+    snap.deck = deck.Snapshot();
+    return snap;
+}
+
+// The rest of a deck, drawn out
+static vector<CardIndex> drawRest(Deck &deck)
+{
+    vector<CardIndex> cards;
+    while (deck.Remaining() > 0)
+        cards.push_back(deck.DrawCard());
+    return cards;
+}
+
+static bool refuses(const string &path)
+{
+    try
+    {
+        MappedFile file(path);
+        size_t count = 0;
+        viewSnapshots(file.data(), file.size(), count);
+        return false;
+    }
+    catch (invalid_argument &)
+    {
+        return true;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    filesystem::path dir = filesystem::temp_directory_path();
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--dir" && i + 1 < argc)
+            dir = argv[++i];
+        else
+        {
+            cerr << "Usage: snapshot_roundtrip [--dir d]\n";
+            return 2;
+        }
+    }
+    string path = (dir / "snapshot_roundtrip.snap").string();
+
+    // Tables from different seeds, seat counts and streets, with the decks they came from
+    vector<TableSnapshot> tables;
+    vector<Deck> decks;
+    for (int t = 0; t < 12; t++)
+    {
+        decks.emplace_back(t % 2 ? FullDeckMask : ShortDeckHoldem::Deck, Xoshiro256::forStream(0x5eed, uint64_t(t)));
+        int seats = 2 + t % (MaxSeats - 1);
+        int board = t % 4 ? 2 + t % 4 : 0;
+        tables.push_back(dealTable(decks.back(), t + 1, seats, board));
+    }
+
+    check(writeSnapshots(path, tables.data(), tables.size()), "write " + path);
+    {
+        MappedFile file(path);
+        size_t count = 0;
+        const TableSnapshot *mapped = viewSnapshots(file.data(), file.size(), count);
+        check(count == tables.size(), "record count");
+        for (size_t t = 0; t < count && t < tables.size(); t++)
+        {
+            check(memcmp(&mapped[t], &tables[t], sizeof(TableSnapshot)) == 0, "table " + to_string(t) + " bytes");
+            check(handCardsValid(mapped[t]), "table " + to_string(t) + " cards check out");
+
+            Deck restored;
+            check(restored.Restore(mapped[t].deck), "table " + to_string(t) + " deck restores");
+            check(drawRest(restored) == drawRest(decks[t]), "table " + to_string(t) + " deals the same cards");
+        }
+    }
+
+    // Deck files
+    string deckPath = (dir / "snapshot_roundtrip.deck").string();
+    Deck saved(FullDeckMask, Xoshiro256::forStream(0x5eed, 99));
+    for (int i = 0; i < 9; i++)
+        saved.DrawCard();
+    check(saved.SaveDeck(deckPath), "write " + deckPath);
+    Deck loaded;
+    check(loaded.LoadDeck(deckPath), "load " + deckPath);
+    check(drawRest(loaded) == drawRest(saved), "loaded deck deals the same cards");
+
+    // Broken files: cut short, wrong magic, a deck with a card twice
+    filesystem::resize_file(path, sizeof(TableSnapshot) + 1);
+    check(refuses(path), "a partial record is refused");
+    TableSnapshot bad = tables[0];
+    bad.magic[0] = 'X';
+    writeSnapshots(path, &bad, 1);
+    check(refuses(path), "a bad magic is refused");
+    bad = tables[0];
+    bad.deck.cards[1] = bad.deck.cards[0];
+    check(!Deck().Restore(bad.deck), "a deck with a repeated card is refused");
+
+    // Hand cards that don't match the deck: not a card, dealt twice, still in the deck
+    bad = tables[1];
+    bad.seats[0].hole[0] = 0x0F;
+    check(!handCardsValid(bad), "a hole card that isn't a card is refused");
+    bad = tables[1];
+    bad.seats[1].hole[1] = bad.board[0];
+    check(!handCardsValid(bad), "a card both in a hand and on the board is refused");
+    bad = tables[1];
+    bad.seats[0].hole[1] = bad.deck.cards[bad.deck.dealt];
+    check(!handCardsValid(bad), "a card the deck hasn't dealt is refused");
+
+    error_code ec;
+    filesystem::remove(path, ec);
+    filesystem::remove(deckPath, ec);
+
+    if (failures)
+        return 1;
+    cout << "Snapshot round trip OK (" << tables.size() << " tables)\n";
+    return 0;
+}
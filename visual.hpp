@@ -9,6 +9,7 @@
 #include <algorithm>
 #include <unordered_map>
 #include "poker_networking.hpp"
+#include "game_variant.hpp"
 
 using namespace std;
 
@@ -43,7 +44,8 @@ static int straightHighFromValues(vector<int> r)
     return r[4];
 }
 
-static Score score5(const array<valRank, 5> &hand)
+// Reference scorer: slow, but the definition of hand order that hand_eval.hpp has to agree with
+static inline Score score5(const array<valRank, 5> &hand)
 {
     vector<int> value;
     value.reserve(5);
@@ -126,7 +128,7 @@ static Score score5(const array<valRank, 5> &hand)
     return Score{1, valueSorted[0], valueSorted[1], valueSorted[2], valueSorted[3], valueSorted[4]}; // High Card
 }
 
-static Score bestof7(const array<valRank, 7> &hand)
+static inline Score bestof7(const array<valRank, 7> &hand)
 {
     Score bestScore{0, 0, 0, 0, 0, 0};
 
@@ -151,42 +153,47 @@ static Score bestof7(const array<valRank, 7> &hand)
     return bestScore;
 }
 
-static vector<int> determine_winner(const vector<hand> &playerHand, const vector<valRank> &communityCards)
+// Packs a Score into the HandRank layout used by hand_eval.hpp
+static inline HandRank rankOfScore(const Score &score)
 {
-    vector<Score> bestScores(playerHand.size());
-    for (size_t i = 0; i < playerHand.size(); i++)
-    {
-        array<valRank, 7> cards7;
+    HandRank rank = 0;
+    for (int v : score)
+        rank = rank << 4 | HandRank(v);
+    return rank;
+}
 
-        cards7[0] = playerHand[i].first;
-        cards7[1] = playerHand[i].second;
-        for (int j = 0; j < 5; j++)
-            cards7[2 + j] = communityCards[j];
+static inline Score scoreOfRank(HandRank rank)
+{
+    Score score{};
+    for (int i = 5; i >= 0; i--, rank >>= 4)
+        score[i] = int(rank & 0xF);
+    return score;
+}
 
-        bestScores[i] = bestof7(cards7);
-    }
+static inline HandRank evaluate7(const array<valRank, 7> &hand)
+{
+    CardMask cards = 0;
+    for (auto &card : hand)
+        cards |= cardBit(makeCard(card.value, card.suit));
+    return evaluateMask(cards);
+}
+
+static vector<int> determine_winner(const vector<hand> &playerHand, const vector<CardIndex> &communityCards)
+{
+    CardMask board = maskOf(communityCards);
 
-    Score best = bestScores[0];
+    vector<CardMask> holes;
+    for (auto &h : playerHand)
+        holes.push_back(cardBit(h.first) | cardBit(h.second));
 
-    for (size_t i = 1; i < bestScores.size(); i++)
-    {
-        if (scoreLess(best, bestScores[i]))
-        {
-            best = bestScores[i];
-        }
-    }
-    vector<int> winners;
-    for (size_t i = 0; i < bestScores.size(); i++)
-    {
-        if (bestScores[i] == best)
-        {
-            winners.push_back(int(i));
-        }
-    }
+    vector<int> winners = determineWinners<Holdem>(holes, board);
+    if (winners.empty())
+        return winners;
+    HandRank best = evaluateHand<Holdem>(holes[winners[0]], board);
 
     if (winners.size() == 1)
     {
-        cout << "Player " << winners[0] + 1 << " wins with score: " << best[0] << endl;
+        cout << "Player " << winners[0] + 1 << " wins with score: " << categoryOf(best) << endl;
     }
     else
     {